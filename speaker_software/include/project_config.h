@@ -3,11 +3,23 @@
 // Global project configuration (ESP32-S3 build)
 
 // Audio
-// I2S output sample rate
+// I2S output sample rate; every clip is resampled to it
 constexpr int kAudioOutputSampleRateHz = 48000;
-// MP3 output gain range (0.0 .. 1.0 recommended)
+// Resampler filter length per output sample (8 cheapest .. 32 sharpest, see BENCH RESAMPLE)
+constexpr uint8_t kResamplerTaps = 16;
+// Resampled PCM buffered between the decoder and I2S feeder tasks (frames, ~85 ms at 48 kHz)
+constexpr size_t kAudioRingFrames = 4096;
+// Core for the audio tasks (the Arduino loop task, web portal and serial CLI run on core 1)
+constexpr int kAudioTaskCore = 0;
+// PSRAM budget for decoded clips (mono 16-bit, ~20 s at 24 kHz)
+constexpr size_t kPcmCacheBytes = 1024 * 1024;
+// Output gain range of the volume pot (0.0 .. 1.0), applied as Q15 by the audio task
 constexpr float kMp3GainMin = 0.1f;
 constexpr float kMp3GainMax = 1.0f;
+// Volume pot sampling period; readings are low-pass filtered
+constexpr uint32_t kVolumePollMs = 20;
+// Synthesize MP3 at half the clip rate (12 kHz for the 24 kHz speech clips); trades treble for decode time
+constexpr bool kMp3HalfSampleRate = false;
 // Speech language selection
 enum class SpeechLanguage : uint8_t {
   kGerman = 0,
@@ -17,6 +29,28 @@ constexpr SpeechLanguage kSpeechLanguage = SpeechLanguage::kGerman;
 // Base paths for audio files in LittleFS (MP3 files).
 constexpr const char* kAudioBasePathDe = "/mp3";
 constexpr const char* kAudioBasePathEn = "/mp3_en";
+// Voice packs built by tools/voice_pack; when present they replace the clip directories above
+constexpr const char* kVoicePackPathDe = "/voice_de.vpk";
+constexpr const char* kVoicePackPathEn = "/voice_en.vpk";
+// Raw flash partitions holding the same packs; mapped in place, they take precedence over the files
+constexpr const char* kVoicePartitionDe = "voice_de";
+constexpr const char* kVoicePartitionEn = "voice_en";
+// Speech bounds of the loose clip files, measured on their first playback
+constexpr const char* kTrimIndexPath = "/trim.idx";
+// Speech detection level (about -45 dBFS, as in tools/voice_pack) and silence kept around the speech
+constexpr int kTrimThreshold = 184;
+constexpr uint16_t kTrimPadMs = 10;
+// Silence between trimmed clips: default, after the English weekday, between time and date.
+// A pause of 0 overlaps the clips by kCrossfadeMs instead (raised-cosine crossfade, max ~21 ms at 24 kHz)
+constexpr uint16_t kClipPauseMs = 0;
+constexpr uint16_t kCrossfadeMs = 10;
+constexpr uint16_t kWeekdayPauseMs = 100;
+constexpr uint16_t kTimeDatePauseMs = 500;
+// Press-to-first-sample traces kept in LittleFS (serial TRACE prints them). Storing
+// writes flash on every press before the power latch lets go; off, traces are only printed.
+constexpr bool kBootTraceStore = false;
+constexpr const char* kBootTracePath = "/boot_trace.bin";
+constexpr size_t kBootTraceKeep = 8;
 inline const char* audio_base_path_for(SpeechLanguage lang) {
   return (lang == SpeechLanguage::kEnglish) ? kAudioBasePathEn : kAudioBasePathDe;
 }
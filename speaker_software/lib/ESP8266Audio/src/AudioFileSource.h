@@ -37,6 +37,7 @@ class AudioFileSource
     virtual bool isOpen() { return false; };
     virtual uint32_t getSize() { return 0; };
     virtual uint32_t getPos() { return 0; };
+    virtual const uint8_t *getMapped() { return NULL; }; // Whole source in addressable memory (e.g. mmap'd flash), else NULL
     virtual bool loop() { return true; };
 
   public:
@@ -0,0 +1,352 @@
+/*
+  AudioFileSourceMP4
+  Reads the AAC track of an MP4/M4A file as an ADTS stream
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "AudioFileSourceMP4.h"
+
+static uint32_t BE32(const uint8_t *p)
+{
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static const uint32_t aacRates[13] = {96000, 88200, 64000, 48000, 44100, 32000, 24000,
+                                      22050, 16000, 12000, 11025, 8000, 7350};
+
+AudioFileSourceMP4::AudioFileSourceMP4()
+{
+  src = NULL;
+  valid = false;
+  sampleRate = 0;
+  channels = 0;
+  frameCount = 0;
+  chunkCount = 0;
+  streamSize = 0;
+  pos = 0;
+  frame = 0;
+  frameOffset = 0;
+  inFrame = 0;
+  chunk = 0;
+  srcPos = UINT32_MAX;
+}
+
+AudioFileSourceMP4::AudioFileSourceMP4(AudioFileSource *src) : AudioFileSourceMP4()
+{
+  begin(src);
+}
+
+AudioFileSourceMP4::~AudioFileSourceMP4()
+{
+}
+
+uint32_t AudioFileSourceMP4::ReadAt(uint32_t at, void *data, uint32_t len)
+{
+  if (srcPos != at && !src->seek(at, SEEK_SET)) {
+    srcPos = UINT32_MAX;
+    return 0;
+  }
+  uint32_t got = src->read(data, len);
+  srcPos = at + got;
+  return got;
+}
+
+// First box of the given type inside [at, end)
+bool AudioFileSourceMP4::FindBox(uint32_t at, uint32_t end, const char *type, uint32_t *body, uint32_t *boxEnd)
+{
+  while (at < end && end - at >= 8) {
+    uint8_t hdr[16];
+    if (ReadAt(at, hdr, 8) != 8) return false;
+    uint32_t size = BE32(hdr);
+    uint32_t header = 8;
+    if (size == 1) { // 64-bit size, only accepted below 4 GB
+      if (end - at < 16 || ReadAt(at + 8, hdr + 8, 8) != 8 || BE32(hdr + 8) != 0) return false;
+      size = BE32(hdr + 12);
+      header = 16;
+    } else if (size == 0) { // up to the end of the enclosing box
+      size = end - at;
+    }
+    if (size < header || size > end - at) return false;
+    if (!memcmp(hdr + 4, type, 4)) {
+      *body = at + header;
+      *boxEnd = at + size;
+      return true;
+    }
+    at += size;
+  }
+  return false;
+}
+
+bool AudioFileSourceMP4::begin(AudioFileSource *source)
+{
+  src = source;
+  valid = false;
+  srcPos = UINT32_MAX;
+  if (!src || !src->isOpen()) return false;
+
+  // moov usually follows mdat in files written without "faststart"
+  uint32_t moov, moovEnd;
+  if (!FindBox(0, src->getSize(), "moov", &moov, &moovEnd)) {
+    audioLogger->printf_P(PSTR("AudioFileSourceMP4: no moov box\n"));
+    return false;
+  }
+  uint32_t at = moov;
+  uint32_t trak, trakEnd;
+  while (!valid && FindBox(at, moovEnd, "trak", &trak, &trakEnd)) {
+    valid = ParseTrack(trak, trakEnd);
+    at = trakEnd;
+  }
+  if (!valid) {
+    audioLogger->printf_P(PSTR("AudioFileSourceMP4: no AAC-LC track\n"));
+    return false;
+  }
+
+  streamSize = 0;
+  for (uint32_t i = 0; i < frameCount; i++) streamSize += adtsHeaderBytes + frameSize[i];
+  StartFrame(0);
+  pos = 0;
+  return true;
+}
+
+bool AudioFileSourceMP4::ParseTrack(uint32_t trakBody, uint32_t trakEnd)
+{
+  uint32_t mdia, mdiaEnd, hdlr, hdlrEnd, minf, minfEnd, stbl, stblEnd;
+  uint8_t handler[12];
+  if (!FindBox(trakBody, trakEnd, "mdia", &mdia, &mdiaEnd)) return false;
+  if (!FindBox(mdia, mdiaEnd, "hdlr", &hdlr, &hdlrEnd) || hdlrEnd - hdlr < 12) return false;
+  if (ReadAt(hdlr, handler, 12) != 12 || memcmp(handler + 8, "soun", 4)) return false;
+  if (!FindBox(mdia, mdiaEnd, "minf", &minf, &minfEnd)) return false;
+  if (!FindBox(minf, minfEnd, "stbl", &stbl, &stblEnd)) return false;
+
+  // stsd -> mp4a -> esds; the mp4a sample entry has 28 bytes before its child boxes
+  uint32_t stsd, stsdEnd, mp4a, mp4aEnd, esds, esdsEnd;
+  if (!FindBox(stbl, stblEnd, "stsd", &stsd, &stsdEnd) || stsdEnd - stsd < 8) return false;
+  if (!FindBox(stsd + 8, stsdEnd, "mp4a", &mp4a, &mp4aEnd) || mp4aEnd - mp4a < 28) return false;
+  if (!FindBox(mp4a + 28, mp4aEnd, "esds", &esds, &esdsEnd)) return false;
+  return ParseEsds(esds, esdsEnd) && ParseTables(stbl, stblEnd);
+}
+
+// ES_Descriptor -> DecoderConfigDescriptor -> DecoderSpecificInfo (ISO 14496-1),
+// which holds the AudioSpecificConfig
+bool AudioFileSourceMP4::ParseEsds(uint32_t body, uint32_t end)
+{
+  uint8_t d[64];
+  uint32_t len = end - body;
+  if (len > sizeof(d)) len = sizeof(d); // the config comes first, the rest is not needed
+  if (ReadAt(body, d, len) != len) return false;
+
+  uint32_t p = 4; // version, flags
+  uint8_t tag = 0;
+  uint32_t descLen = 0;
+  auto descriptor = [&]() {
+    if (p >= len) return false;
+    tag = d[p++];
+    descLen = 0;
+    for (int i = 0; i < 4; i++) {
+      if (p >= len) return false;
+      uint8_t b = d[p++];
+      descLen = (descLen << 7) | (b & 0x7f);
+      if (!(b & 0x80)) break;
+    }
+    return true;
+  };
+  if (!descriptor() || tag != 0x03 || len - p < 3) return false;
+  uint8_t flags = d[p + 2];
+  p += 3; // ES_ID, flags
+  if (flags & 0x80) p += 2;                         // dependsOn_ES_ID
+  if (flags & 0x40) p += (p < len ? d[p] : 0) + 1;  // URL
+  if (flags & 0x20) p += 2;                         // OCR_ES_Id
+  if (!descriptor() || tag != 0x04 || len - p < 13) return false;
+  uint8_t objectType = d[p];
+  p += 13;
+  if (!descriptor() || tag != 0x05 || descLen < 2 || len - p < 2) return false;
+
+  // AudioSpecificConfig: object type (5 bits), rate index (4), channel config (4)
+  int aot = d[p] >> 3;
+  int rateIndex = ((d[p] & 7) << 1) | (d[p + 1] >> 7);
+  int chans = (d[p + 1] >> 3) & 0x0f;
+  if (objectType != 0x40 || aot != 2 || rateIndex > 12 || chans < 1 || chans > 2) return false;
+  sampleRate = aacRates[rateIndex];
+  channels = chans;
+
+  // ADTS header without CRC: MPEG-4, one raw data block, buffer fullness 0x7ff
+  adts[0] = 0xff;
+  adts[1] = 0xf1;
+  adts[2] = ((aot - 1) << 6) | (rateIndex << 2) | (chans >> 2);
+  adts[3] = (chans & 3) << 6;
+  adts[4] = 0;
+  adts[5] = 0x1f;
+  adts[6] = 0xfc;
+  return true;
+}
+
+bool AudioFileSourceMP4::ParseTables(uint32_t stbl, uint32_t stblEnd)
+{
+  uint32_t stsz, stszEnd, stsc, stscEnd, stco, stcoEnd;
+  bool co64 = !FindBox(stbl, stblEnd, "stco", &stco, &stcoEnd);
+  if (co64 && !FindBox(stbl, stblEnd, "co64", &stco, &stcoEnd)) return false;
+  if (!FindBox(stbl, stblEnd, "stsz", &stsz, &stszEnd)) return false;
+  if (!FindBox(stbl, stblEnd, "stsc", &stsc, &stscEnd)) return false;
+
+  uint8_t b[128];
+  // Sample sizes: one fixed size, or a table
+  if (ReadAt(stsz, b, 12) != 12) return false;
+  uint32_t fixedSize = BE32(b + 4);
+  frameCount = BE32(b + 8);
+  if (frameCount == 0 || frameCount > maxFrames) {
+    audioLogger->printf_P(PSTR("AudioFileSourceMP4: %u frames, max %d\n"), (unsigned)frameCount, maxFrames);
+    return false;
+  }
+  if (!fixedSize && stszEnd - stsz < 12 + frameCount * 4) return false;
+  for (uint32_t i = 0; i < frameCount; i += sizeof(b) / 4) {
+    uint32_t n = (frameCount - i < sizeof(b) / 4) ? frameCount - i : sizeof(b) / 4;
+    if (!fixedSize && ReadAt(stsz + 12 + i * 4, b, n * 4) != n * 4) return false;
+    for (uint32_t k = 0; k < n; k++) {
+      uint32_t size = fixedSize ? fixedSize : BE32(b + k * 4);
+      if (size == 0 || size > 0x1fff - adtsHeaderBytes) return false; // 13-bit ADTS frame length
+      frameSize[i + k] = size;
+    }
+  }
+
+  // Chunk offsets, 32 or 64 bit
+  if (ReadAt(stco, b, 8) != 8) return false;
+  chunkCount = BE32(b + 4);
+  const uint32_t entry = co64 ? 8 : 4;
+  if (chunkCount == 0 || chunkCount > maxChunks || stcoEnd - stco < 8 + chunkCount * entry) return false;
+  for (uint32_t i = 0; i < chunkCount; i += sizeof(b) / entry) {
+    uint32_t n = (chunkCount - i < sizeof(b) / entry) ? chunkCount - i : sizeof(b) / entry;
+    if (ReadAt(stco + 8 + i * entry, b, n * entry) != n * entry) return false;
+    for (uint32_t k = 0; k < n; k++) {
+      if (co64 && BE32(b + k * 8) != 0) return false;
+      chunkOffset[i + k] = BE32(b + k * entry + (co64 ? 4 : 0));
+    }
+  }
+
+  // Sample-to-chunk: runs of chunks with the same number of samples
+  if (ReadAt(stsc, b, 8) != 8) return false;
+  uint32_t runs = BE32(b + 4);
+  if (runs == 0 || stscEnd - stsc < 8 + runs * 12) return false;
+  uint32_t next = 1;
+  uint32_t frames = 0;
+  for (uint32_t r = 0; r < runs; r++) {
+    // This run and the first chunk of the next one
+    uint32_t n = (r + 1 < runs) ? 16 : 12;
+    if (ReadAt(stsc + 8 + r * 12, b, n) != n) return false;
+    uint32_t first = BE32(b);
+    uint32_t perChunk = BE32(b + 4);
+    uint32_t last = (r + 1 < runs) ? BE32(b + 12) : chunkCount + 1;
+    if (first != next || last < first || perChunk > maxFrames) return false;
+    for (uint32_t c = first; c < last && c <= chunkCount; c++) {
+      chunkFirstFrame[c - 1] = (frames < frameCount) ? frames : frameCount;
+      frames += perChunk;
+    }
+    next = last;
+  }
+  if (next <= chunkCount || frames < frameCount) {
+    audioLogger->printf_P(PSTR("AudioFileSourceMP4: sample table does not cover all frames\n"));
+    return false;
+  }
+  return true;
+}
+
+void AudioFileSourceMP4::StartFrame(uint32_t f)
+{
+  frame = f;
+  inFrame = 0;
+  chunk = 0;
+  while (chunk + 1 < chunkCount && chunkFirstFrame[chunk + 1] <= f) chunk++;
+  frameOffset = chunkOffset[chunk];
+  for (uint32_t i = chunkFirstFrame[chunk]; i < f; i++) frameOffset += frameSize[i];
+}
+
+void AudioFileSourceMP4::NextFrame()
+{
+  frameOffset += frameSize[frame];
+  frame++;
+  inFrame = 0;
+  while (chunk + 1 < chunkCount && chunkFirstFrame[chunk + 1] <= frame) {
+    chunk++;
+    frameOffset = chunkOffset[chunk];
+  }
+}
+
+uint32_t AudioFileSourceMP4::read(void *data, uint32_t len)
+{
+  uint8_t *out = reinterpret_cast<uint8_t*>(data);
+  uint32_t done = 0;
+  while (valid && done < len && frame < frameCount) {
+    uint32_t total = adtsHeaderBytes + frameSize[frame];
+    uint32_t n;
+    if (inFrame < adtsHeaderBytes) {
+      adts[3] = (adts[3] & 0xfc) | (total >> 11);
+      adts[4] = total >> 3;
+      adts[5] = ((total & 7) << 5) | 0x1f;
+      n = adtsHeaderBytes - inFrame;
+      if (n > len - done) n = len - done;
+      memcpy(out + done, adts + inFrame, n);
+    } else {
+      n = total - inFrame;
+      if (n > len - done) n = len - done;
+      n = ReadAt(frameOffset + inFrame - adtsHeaderBytes, out + done, n);
+      if (n == 0) break; // truncated file
+    }
+    done += n;
+    inFrame += n;
+    pos += n;
+    if (inFrame == total) NextFrame();
+  }
+  return done;
+}
+
+bool AudioFileSourceMP4::seek(int32_t offset, int dir)
+{
+  if (!valid) return false;
+  int64_t target = offset;
+  if (dir == SEEK_CUR) target += pos;
+  else if (dir == SEEK_END) target += streamSize;
+  if (target < 0 || target > streamSize) return false;
+
+  uint32_t f = 0;
+  uint32_t at = 0;
+  while (f < frameCount && at + adtsHeaderBytes + frameSize[f] <= target) {
+    at += adtsHeaderBytes + frameSize[f];
+    f++;
+  }
+  StartFrame(f);
+  inFrame = target - at;
+  pos = target;
+  return true;
+}
+
+bool AudioFileSourceMP4::close()
+{
+  valid = false;
+  return src ? src->close() : false;
+}
+
+bool AudioFileSourceMP4::isOpen()
+{
+  return valid && src && src->isOpen();
+}
+
+uint32_t AudioFileSourceMP4::getSize()
+{
+  return valid ? streamSize : 0;
+}
+
+uint32_t AudioFileSourceMP4::getPos()
+{
+  return pos;
+}
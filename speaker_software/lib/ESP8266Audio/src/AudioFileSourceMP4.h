@@ -0,0 +1,88 @@
+/*
+  AudioFileSourceMP4
+  Reads the AAC track of an MP4/M4A file as an ADTS stream
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _AUDIOFILESOURCEMP4_H
+#define _AUDIOFILESOURCEMP4_H
+
+#include <Arduino.h>
+
+#include "AudioFileSource.h"
+
+// begin() reads the sample tables (stsz, stsc, stco/co64) and the decoder
+// config (esds) of the first audio track once, wherever the moov box is.
+// read() then returns each access unit behind a 7-byte ADTS header built
+// from that config, which is what AudioGeneratorAAC decodes. AAC-LC, mono
+// or stereo; the tables live in fixed arrays, nothing is allocated.
+class AudioFileSourceMP4 : public AudioFileSource
+{
+  public:
+    AudioFileSourceMP4();
+    AudioFileSourceMP4(AudioFileSource *src);
+    virtual ~AudioFileSourceMP4() override;
+
+    bool begin(AudioFileSource *src);
+    virtual uint32_t read(void *data, uint32_t len) override;
+    virtual bool seek(int32_t pos, int dir) override;
+    virtual bool close() override;
+    virtual bool isOpen() override;
+    virtual uint32_t getSize() override;
+    virtual uint32_t getPos() override;
+
+    int getSampleRate() const { return sampleRate; }
+    int getChannels() const { return channels; }
+    uint32_t getFrames() const { return frameCount; }
+
+    static constexpr int maxFrames = 1024; // ~43 s at 24 kHz
+    static constexpr int maxChunks = 256;
+    static constexpr int adtsHeaderBytes = 7;
+
+  private:
+    uint32_t ReadAt(uint32_t at, void *data, uint32_t len);
+    bool FindBox(uint32_t at, uint32_t end, const char *type, uint32_t *body, uint32_t *boxEnd);
+    bool ParseTrack(uint32_t trakBody, uint32_t trakEnd);
+    bool ParseEsds(uint32_t body, uint32_t end);
+    bool ParseTables(uint32_t stblBody, uint32_t stblEnd);
+    void StartFrame(uint32_t f);
+    void NextFrame();
+
+  private:
+    AudioFileSource *src;
+    bool valid;
+
+    int sampleRate;
+    int channels;
+    uint8_t adts[adtsHeaderBytes]; // frame length filled in per frame
+
+    uint32_t frameCount;
+    uint16_t frameSize[maxFrames];
+    uint32_t chunkCount;
+    uint32_t chunkOffset[maxChunks];
+    uint16_t chunkFirstFrame[maxChunks];
+    uint32_t streamSize; // ADTS bytes of all frames
+
+    // Read position
+    uint32_t pos;
+    uint32_t frame;
+    uint32_t frameOffset; // file offset of the current frame's data
+    uint32_t inFrame;     // bytes of the current ADTS frame already returned
+    uint32_t chunk;
+    uint32_t srcPos;      // where the source is positioned, UINT32_MAX if unknown
+};
+
+#endif
+
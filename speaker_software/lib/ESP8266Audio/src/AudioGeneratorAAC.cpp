@@ -63,16 +63,16 @@ AudioGeneratorAAC::AudioGeneratorAAC(void *preallocateData, int preallocateSz)
 
   uint8_t *p = (uint8_t*)preallocateSpace;
   buff = (uint8_t*) p;
-  p += (buffLen + 7) & ~7;
+  p += preAllocBuffSize();
   outSample = (int16_t*) p;
-  p += (1024 * 2 * sizeof(int16_t) + 7) & ~7;
-  int used = p - (uint8_t*)preallocateSpace;
-  int availSpace = preallocateSize - used;
-  if (availSpace < 0 ) {
-    audioLogger->printf_P(PSTR("ERROR: Out of memory in AAC\n"));
-  }
+  p += preAllocOutSize();
 
-  hAACDecoder = AACInitDecoderPre(p, availSpace);
+  hAACDecoder = NULL;
+  if (preallocateSize < preAllocSize()) {
+    audioLogger->printf_P(PSTR("ERROR: AAC needs %d bytes, got %d\n"), preAllocSize(), preallocateSize);
+  } else {
+    hAACDecoder = AACInitDecoderPre(p, preallocateSize - preAllocBuffSize() - preAllocOutSize());
+  }
   if (!hAACDecoder) {
     audioLogger->printf_P(PSTR("Out of memory error! hAACDecoder==NULL\n"));
     Serial.flush();
@@ -201,6 +201,16 @@ bool AudioGeneratorAAC::begin(AudioFileSource *source, AudioOutput *output)
   this->output = output;
   if (!file->isOpen()) return false; // Error
 
+  // Every stream starts from a clean decoder
+  if (preallocateSpace) {
+    if (preallocateSize < preAllocSize()) return false;
+    uint8_t *p = (uint8_t*)preallocateSpace + preAllocBuffSize() + preAllocOutSize();
+    hAACDecoder = AACInitDecoderPre(p, preallocateSize - preAllocBuffSize() - preAllocOutSize());
+  } else if (hAACDecoder) {
+    AACFlushCodec(hAACDecoder);
+  }
+  if (!hAACDecoder) return false;
+
   output->begin();
   
   // AAC always comes out at 16 bits
@@ -209,6 +219,12 @@ bool AudioGeneratorAAC::begin(AudioFileSource *source, AudioOutput *output)
 
   memset(buff, 0, buffLen);
   memset(outSample, 0, 1024*2*sizeof(int16_t));
+  buffValid = 0;
+  lastFrameEnd = 0;
+  validSamples = 0;
+  curSample = 0;
+  lastRate = 0;
+  lastChannels = 0;
 
  
   running = true;
@@ -35,6 +35,12 @@ class AudioGeneratorAAC : public AudioGenerator
     virtual bool stop() override;
     virtual bool isRunning() override;
 
+    // Space the preallocating constructor needs: the input and output buffers,
+    // then the decoder state (AAC_PREALLOC_SIZE, SBR included as built here)
+    static constexpr int preAllocSize () { return preAllocBuffSize() + preAllocOutSize() + AAC_PREALLOC_SIZE; }
+    static constexpr int preAllocBuffSize () { return (buffLen + 7) & ~7; }
+    static constexpr int preAllocOutSize () { return (1024 * 2 * sizeof(int16_t) + 7) & ~7; }
+
   protected:
     void *preallocateSpace;
     int preallocateSize;
@@ -43,7 +49,7 @@ class AudioGeneratorAAC : public AudioGenerator
     HAACDecoder hAACDecoder;
 
     // Input buffering
-    const int buffLen = 1600;
+    static constexpr int buffLen = 1600;
     uint8_t *buff; //[1600]; // File buffer required to store at least a whole compressed frame
     int16_t buffValid;
     int16_t lastFrameEnd;
@@ -0,0 +1,166 @@
+/*
+  AudioGeneratorADPCM
+  Audio output generator for mono 4-bit IMA ADPCM WAV files (format 0x0011)
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "AudioGeneratorADPCM.h"
+
+AudioGeneratorADPCM::AudioGeneratorADPCM()
+{
+  running = false;
+  file = NULL;
+  output = NULL;
+  sampleRate = 0;
+  blockAlign = 0;
+  availBytes = 0;
+  samplesLeft = 0;
+  pcmPtr = 0;
+  pcmLen = 0;
+}
+
+AudioGeneratorADPCM::~AudioGeneratorADPCM()
+{
+}
+
+bool AudioGeneratorADPCM::stop()
+{
+  if (!running) return true;
+  running = false;
+  output->stop();
+  return file->close();
+}
+
+bool AudioGeneratorADPCM::isRunning()
+{
+  return running;
+}
+
+bool AudioGeneratorADPCM::DecodeBlock()
+{
+  if (availBytes == 0 || samplesLeft == 0) return false;
+  const uint32_t want = availBytes < blockAlign ? availBytes : blockAlign;
+  const uint32_t got = file->read(block, want);
+  availBytes = (got < want) ? 0 : availBytes - got;
+  const int room = samplesLeft < (uint32_t)maxBlockSamples ? samplesLeft : maxBlockSamples;
+  // Decode into the back half, then spread each sample to both channels front to back
+  int16_t *mono = &pcm[0][0] + maxBlockSamples;
+  const int n = ima_adpcm_decode_block(block, got, mono, room);
+  if (n == 0) return false;
+  for (int i = 0; i < n; i++) {
+    const int16_t s = mono[i];
+    pcm[i][AudioOutput::LEFTCHANNEL] = s;
+    pcm[i][AudioOutput::RIGHTCHANNEL] = s;
+  }
+  if (samplesLeft != UINT32_MAX) samplesLeft -= n;
+  pcmPtr = 0;
+  pcmLen = n;
+  return true;
+}
+
+bool AudioGeneratorADPCM::loop()
+{
+  if (!running) goto done; // Nothing to do here!
+
+  while (running) {
+    // Hand the rest of the block to the output.  If it can't take it all, punt and try later
+    if (pcmPtr < pcmLen) {
+      pcmPtr += output->ConsumeSamples(&pcm[pcmPtr][0], pcmLen - pcmPtr);
+      if (pcmPtr < pcmLen) goto done; // Can't send, but no error detected
+    }
+    if (!DecodeBlock()) return false; // End of data, the caller stops us
+  }
+
+done:
+  file->loop();
+  output->loop();
+
+  return running;
+}
+
+bool AudioGeneratorADPCM::ReadWAVInfo()
+{
+  uint32_t u32;
+
+  // "RIFF", size, "WAVE"
+  if (!ReadU32(&u32) || (u32 != 0x46464952) || !ReadU32(&u32) || !ReadU32(&u32) || (u32 != 0x45564157)) {
+    audioLogger->printf_P(PSTR("AudioGeneratorADPCM: not a WAV file\n"));
+    return false;
+  }
+
+  bool haveFmt = false;
+  samplesLeft = UINT32_MAX;
+  while (1) {
+    uint32_t id, size;
+    if (!ReadU32(&id) || !ReadU32(&size)) {
+      audioLogger->printf_P(PSTR("AudioGeneratorADPCM: no data chunk\n"));
+      return false;
+    }
+    uint32_t used = 0;
+    if (id == 0x20746d66) { // "fmt "
+      uint16_t format, channels, bits, extra, samplesPerBlock;
+      uint32_t byteRate;
+      if ((size < 20) || !ReadU16(&format) || !ReadU16(&channels) || !ReadU32(&sampleRate) || !ReadU32(&byteRate) ||
+          !ReadU16(&blockAlign) || !ReadU16(&bits) || !ReadU16(&extra) || !ReadU16(&samplesPerBlock)) {
+        audioLogger->printf_P(PSTR("AudioGeneratorADPCM: short fmt chunk\n"));
+        return false;
+      }
+      if ((format != 0x0011) || (channels != 1) || (bits != 4) || (sampleRate == 0) ||
+          (blockAlign <= IMA_ADPCM_HEADER_BYTES) || (blockAlign > maxBlockBytes)) {
+        audioLogger->printf_P(PSTR("AudioGeneratorADPCM: only mono 4-bit IMA ADPCM, blocks up to %d bytes\n"), maxBlockBytes);
+        return false;
+      }
+      haveFmt = true;
+      used = 20;
+    } else if (id == 0x74636166) { // "fact"
+      if ((size < 4) || !ReadU32(&samplesLeft)) return false;
+      used = 4;
+    } else if (id == 0x61746164) { // "data"
+      if (!haveFmt) {
+        audioLogger->printf_P(PSTR("AudioGeneratorADPCM: data before fmt\n"));
+        return false;
+      }
+      availBytes = size;
+      return true;
+    }
+    // Chunks are word aligned
+    const uint32_t rest = size - used + (size & 1);
+    if (rest && !file->seek(rest, SEEK_CUR)) return false;
+  }
+}
+
+bool AudioGeneratorADPCM::begin(AudioFileSource *source, AudioOutput *output)
+{
+  if (!source || !output) return false;
+  file = source;
+  this->output = output;
+  if (!file->isOpen()) {
+    audioLogger->printf_P(PSTR("AudioGeneratorADPCM::begin: file not open\n"));
+    return false;
+  }
+  pcmPtr = 0;
+  pcmLen = 0;
+  if (!ReadWAVInfo()) return false;
+
+  if (!output->SetRate(sampleRate) || !output->SetBitsPerSample(16) || !output->SetChannels(1)) {
+    audioLogger->printf_P(PSTR("AudioGeneratorADPCM::begin: output rejected the format\n"));
+    return false;
+  }
+  if (!output->begin()) return false;
+
+  running = true;
+  return true;
+}
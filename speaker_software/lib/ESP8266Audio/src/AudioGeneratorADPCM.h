@@ -0,0 +1,58 @@
+/*
+  AudioGeneratorADPCM
+  Audio output generator for mono 4-bit IMA ADPCM WAV files (format 0x0011)
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _AUDIOGENERATORADPCM_H
+#define _AUDIOGENERATORADPCM_H
+
+#include "AudioGenerator.h"
+#include "libima/ima_adpcm.h"
+
+// Decodes one block per loop() pass into a fixed buffer and hands it to the
+// output in one ConsumeSamples() call; nothing is allocated.
+class AudioGeneratorADPCM : public AudioGenerator
+{
+  public:
+    AudioGeneratorADPCM();
+    virtual ~AudioGeneratorADPCM() override;
+    virtual bool begin(AudioFileSource *source, AudioOutput *output) override;
+    virtual bool loop() override;
+    virtual bool stop() override;
+    virtual bool isRunning() override;
+
+    static constexpr int maxBlockBytes = 512;
+    static constexpr int maxBlockSamples = 1 + 2 * (maxBlockBytes - IMA_ADPCM_HEADER_BYTES);
+
+  private:
+    bool ReadU32(uint32_t *dest) { return file->read(reinterpret_cast<uint8_t*>(dest), 4) == 4; }
+    bool ReadU16(uint16_t *dest) { return file->read(reinterpret_cast<uint8_t*>(dest), 2) == 2; }
+    bool ReadWAVInfo();
+    bool DecodeBlock();
+
+  protected:
+    uint32_t sampleRate;
+    uint16_t blockAlign;
+    uint32_t availBytes;  // Data chunk bytes not read yet
+    uint32_t samplesLeft; // From the fact chunk, UINT32_MAX without one
+
+    uint8_t block[maxBlockBytes];
+    int16_t pcm[maxBlockSamples][2];
+    int pcmPtr;
+    int pcmLen;
+};
+
+#endif
@@ -20,6 +20,8 @@
 
 
 #include "AudioGeneratorMP3.h"
+#include <ctype.h>
+#include <string.h>
 
 AudioGeneratorMP3::AudioGeneratorMP3()
 {
@@ -27,8 +29,18 @@ AudioGeneratorMP3::AudioGeneratorMP3()
   file = NULL;
   output = NULL;
   buff = NULL;
+  stream = NULL;
+  frame = NULL;
+  synth = NULL;
   nsCountMax = 1152/32;
   madInitted = false;
+  madOptions = 0;
+  mapped = NULL;
+  mappedLen = 0;
+  guardAdded = false;
+  gaplessChecked = true;
+  gaplessSkip = 0;
+  gaplessLeft = UINT32_MAX;
 }
 
 AudioGeneratorMP3::AudioGeneratorMP3(void *space, int size): preallocateSpace(space), preallocateSize(size)
@@ -37,8 +49,18 @@ AudioGeneratorMP3::AudioGeneratorMP3(void *space, int size): preallocateSpace(sp
   file = NULL;
   output = NULL;
   buff = NULL;
+  stream = NULL;
+  frame = NULL;
+  synth = NULL;
   nsCountMax = 1152/32;
   madInitted = false;
+  madOptions = 0;
+  mapped = NULL;
+  mappedLen = 0;
+  guardAdded = false;
+  gaplessChecked = true;
+  gaplessSkip = 0;
+  gaplessLeft = UINT32_MAX;
 }
 
 AudioGeneratorMP3::AudioGeneratorMP3(void *buff, int buffSize, void *stream, int streamSize, void *frame, int frameSize, void *synth, int synthSize):
@@ -51,8 +73,18 @@ AudioGeneratorMP3::AudioGeneratorMP3(void *buff, int buffSize, void *stream, int
   file = NULL;
   output = NULL;
   buff = NULL;
+  stream = NULL;
+  frame = NULL;
+  synth = NULL;
   nsCountMax = 1152/32;
   madInitted = false;
+  madOptions = 0;
+  mapped = NULL;
+  mappedLen = 0;
+  guardAdded = false;
+  gaplessChecked = true;
+  gaplessSkip = 0;
+  gaplessLeft = UINT32_MAX;
 }
 
 AudioGeneratorMP3::~AudioGeneratorMP3()
@@ -107,7 +139,7 @@ enum mad_flow AudioGeneratorMP3::ErrorToFlow()
 
   strcpy_P(err, mad_stream_errorstr(stream));
   snprintf_P(errLine, sizeof(errLine), PSTR("Decoding error '%s' at byte offset %d"),
-           err, (stream->this_frame - buff) + lastReadPos);
+           err, (stream->this_frame - (mapped ? mapped : buff)) + lastReadPos);
   yield(); // Something bad happened anyway, ensure WiFi gets some time, too
   cb.st(stream->error, errLine);
   return MAD_FLOW_CONTINUE;
@@ -117,6 +149,29 @@ enum mad_flow AudioGeneratorMP3::Input()
 {
   int unused = 0;
 
+  if (mapped) {
+    // The whole source is one libmad buffer, so there is nothing to refill and running out is the end
+    if (lastBuffLen == 0) {
+      lastReadPos = file->getPos();
+      lastBuffLen = mappedLen - lastReadPos;
+      if (lastBuffLen <= 0) return MAD_FLOW_STOP;
+      mad_stream_buffer(stream, mapped + lastReadPos, lastBuffLen);
+      return MAD_FLOW_CONTINUE;
+    }
+    if (stream->error != MAD_ERROR_BUFLEN) return MAD_FLOW_CONTINUE;
+    // Only the last frame is left; copy it out of the mapping with the guard bytes libmad needs after it
+    const unsigned char *tail = stream->next_frame ? stream->next_frame : stream->this_frame;
+    unused = tail ? stream->bufend - tail : 0;
+    if (guardAdded || unused <= 0 || unused + MAD_BUFFER_GUARD > buffLen) return MAD_FLOW_STOP;
+    memcpy(buff, tail, unused);
+    memset(buff + unused, 0, MAD_BUFFER_GUARD);
+    guardAdded = true;
+    lastBuffLen = unused + MAD_BUFFER_GUARD;
+    mad_stream_buffer(stream, buff, lastBuffLen);
+    stream->error = MAD_ERROR_NONE;
+    return MAD_FLOW_CONTINUE;
+  }
+
   if (stream->next_frame) {
     unused = lastBuffLen - (stream->next_frame - buff);
     if (unused < 0) {
@@ -136,7 +191,14 @@ enum mad_flow AudioGeneratorMP3::Input()
   lastReadPos = file->getPos() - unused;
   int len = buffLen - unused;
   len = file->read(buff + unused, len);
-  if ((len == 0)  && (unused == 0)) {
+  if ((len == 0) && (unused > 0) && !guardAdded && (unused + MAD_BUFFER_GUARD <= buffLen) &&
+      file->getSize() && (file->getPos() >= file->getSize())) {
+    // End of file: libmad only decodes a frame with MAD_BUFFER_GUARD bytes after it
+    memset(buff + unused, 0, MAD_BUFFER_GUARD);
+    len = MAD_BUFFER_GUARD;
+    guardAdded = true;
+  }
+  if ((len == 0)  && (unused <= (guardAdded ? MAD_BUFFER_GUARD : 0))) {
     // Can't read any from the file, and we don't have anything left.  It's done....
     return MAD_FLOW_STOP;
   }
@@ -168,29 +230,68 @@ bool AudioGeneratorMP3::DecodeNextFrame()
     ErrorToFlow(); // Always returns CONTINUE
     return false;
   }
+  if (!gaplessChecked) {
+    gaplessChecked = true;
+    if (ParseGaplessInfo()) {
+      // The tag frame holds no audio, so it is never synthesized
+      stream->error = MAD_ERROR_NONE;
+      return false;
+    }
+  }
   nsCountMax  = MAD_NSBSAMPLES(&frame->header);
   return true;
 }
 
-bool AudioGeneratorMP3::GetOneSample(int16_t sample[2])
+static uint32_t ReadBE32(const unsigned char *p)
+{
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+bool AudioGeneratorMP3::ParseGaplessInfo()
 {
-  if (synth->pcm.samplerate != lastRate) {
-    output->SetRate(synth->pcm.samplerate);
-    lastRate = synth->pcm.samplerate;
+  // The Xing/Info tag follows the Layer III side info of the first frame; the
+  // offsets and the delay model below do not apply to Layer I/II
+  if (frame->header.layer != MAD_LAYER_III) return false;
+  const unsigned char *p = stream->this_frame;
+  const int len = stream->next_frame - stream->this_frame;
+  const bool lsf = frame->header.flags & MAD_FLAG_LSF_EXT;
+  const bool mono = frame->header.mode == MAD_MODE_SINGLE_CHANNEL;
+  int pos = 4 + ((frame->header.flags & MAD_FLAG_PROTECTION) ? 2 : 0) + (lsf ? (mono ? 9 : 17) : (mono ? 17 : 32));
+  if ((len < pos + 8) || (memcmp(p + pos, "Xing", 4) && memcmp(p + pos, "Info", 4))) return false;
+
+  const uint32_t flags = ReadBE32(p + pos + 4);
+  pos += 8;
+  uint32_t frames = 0;
+  if (flags & 1) {
+    frames = ReadBE32(p + pos);
+    pos += 4;
   }
-  if (synth->pcm.channels != lastChannels) {
-    output->SetChannels(synth->pcm.channels);
-    lastChannels = synth->pcm.channels;
+  if (flags & 2) pos += 4;   // Byte count
+  if (flags & 4) pos += 100; // Seek table
+  if (flags & 8) pos += 4;   // Quality
+  // LAME extension: encoder name ("LAME3.100", "Lavc61.19", ...), then delay and padding as 12 bits each at +21
+  if ((len < pos + 24) || !isalnum(p[pos]) || !isalnum(p[pos + 1]) || !isalnum(p[pos + 2]) || !isalnum(p[pos + 3])) {
+    return true;
   }
+  const int delay = (p[pos + 21] << 4) | (p[pos + 22] >> 4);
+  const int padding = ((p[pos + 22] & 0x0f) << 8) | p[pos + 23];
+
+  // The synthesis filterbank adds another 529 samples of delay on top of the encoder's
+  const int shift = (madOptions & MAD_OPTION_HALFSAMPLERATE) ? 1 : 0;
+  const uint32_t spf = 32 * MAD_NSBSAMPLES(&frame->header);
+  gaplessSkip = (delay + 529) >> shift;
+  if (frames && (frames * spf > (uint32_t)(delay + padding))) {
+    gaplessLeft = (frames * spf - delay - padding) >> shift;
+  }
+  return true;
+}
 
-  // If we're here, we have one decoded frame and sent 0 or more samples out
-  if (samplePtr < synth->pcm.length) {
-    sample[AudioOutput::LEFTCHANNEL ] = synth->pcm.samples[0][samplePtr];
-    sample[AudioOutput::RIGHTCHANNEL] = synth->pcm.samples[1][samplePtr];
-    samplePtr++;
-  } else {
-    samplePtr = 0;
-
+bool AudioGeneratorMP3::FillBlock()
+{
+  // Synthesize granules of the current frame into one interleaved block
+  pcmPtr = 0;
+  pcmLen = 0;
+  while ( (nsCount < nsCountMax) && (pcmLen + 32 <= pcmBlockFrames) ) {
     switch ( mad_synth_frame_onens(synth, frame, nsCount++) ) {
         case MAD_FLOW_STOP:
         case MAD_FLOW_BREAK: audioLogger->printf_P(PSTR("msf1ns failed\n"));
@@ -199,9 +300,22 @@ bool AudioGeneratorMP3::GetOneSample(int16_t sample[2])
           break; // Do nothing
     }
     // for IGNORE and CONTINUE, just play what we have now
-    sample[AudioOutput::LEFTCHANNEL ] = synth->pcm.samples[0][samplePtr];
-    sample[AudioOutput::RIGHTCHANNEL] = synth->pcm.samples[1][samplePtr];
-    samplePtr++;
+    int first = 0;
+    int last = synth->pcm.length;
+    if (gaplessSkip > 0) {
+      first = (gaplessSkip < last) ? gaplessSkip : last;
+      gaplessSkip -= first;
+    }
+    if ((uint32_t)(last - first) > gaplessLeft) last = first + gaplessLeft;
+    if (gaplessLeft != UINT32_MAX) gaplessLeft -= last - first;
+    const int16_t *l = synth->pcm.samples[0];
+    const int16_t *r = (synth->pcm.channels == 2) ? synth->pcm.samples[1] : l;
+    int16_t *d = pcmBlock + 2 * pcmLen;
+    for (int i = first; i < last; i++) {
+      *(d++) = l[i];
+      *(d++) = r[i];
+    }
+    pcmLen += last - first;
   }
   return true;
 }
@@ -211,14 +325,26 @@ bool AudioGeneratorMP3::loop()
 {
   if (!running) goto done; // Nothing to do here!
 
-  // First, try and push in the stored sample.  If we can't, then punt and try later
-  if (!output->ConsumeSample(lastSample)) goto done; // Can't send, but no error detected
+  while (running) {
+    // Hand whatever is pending to the output in one call.  If it can't take it all, punt and try later
+    if (pcmPtr < pcmLen) {
+      if (synth->pcm.samplerate != lastRate) {
+        output->SetRate(synth->pcm.samplerate);
+        lastRate = synth->pcm.samplerate;
+      }
+      if (synth->pcm.channels != lastChannels) {
+        output->SetChannels(synth->pcm.channels);
+        lastChannels = synth->pcm.channels;
+      }
+      pcmPtr += output->ConsumeSamples(pcmBlock + 2 * pcmPtr, pcmLen - pcmPtr);
+      if (pcmPtr < pcmLen) goto done; // Can't send, but no error detected
+    }
+
+    // The rest of the stream is encoder padding
+    if (gaplessLeft == 0) return false;
 
-  // Try and stuff the buffer one sample at a time
-  do
-  {
     // Decode next frame if we're beyond the existing generated data
-    if ( (samplePtr >= synth->pcm.length) && (nsCount >= nsCountMax) ) {
+    if (nsCount >= nsCountMax) {
 retry:
       if (Input() == MAD_FLOW_STOP) {
         return false;
@@ -239,20 +365,15 @@ retry:
         }
         goto retry;
       }
-      samplePtr = 9999;
       nsCount = 0;
     }
 
-    if (!GetOneSample(lastSample)) {
+    if (!FillBlock()) {
       audioLogger->printf_P(PSTR("G1S failed\n"));
       running = false;
       goto done;
     }
-    if (lastChannels == 1)
-    {
-      lastSample[1] = lastSample[0];
-    }
-  } while (running && output->ConsumeSample(lastSample));
+  }
 
 done:
   file->loop();
@@ -262,6 +383,38 @@ done:
 }
 
 
+bool AudioGeneratorMP3::prime()
+{
+  if (!running) return false;
+
+  // Already holding decoded data, nothing to do
+  if ( (pcmPtr < pcmLen) || (nsCount < nsCountMax) ) return true;
+
+  while (true) {
+    if (Input() == MAD_FLOW_STOP) {
+      return false;
+    }
+    if (DecodeNextFrame()) break;
+    if (stream->error == MAD_ERROR_BUFLEN) {
+      if (++unrecoverable >= 3) {
+        unrecoverable = 0;
+        return false;
+      }
+    } else {
+      unrecoverable = 0;
+    }
+  }
+
+  // Synthesize the first block too, but leave SetRate()/SetChannels() to the first loop()
+  nsCount = 0;
+  return FillBlock();
+}
+
+void AudioGeneratorMP3::SetDecodeOptions(int options)
+{
+  madOptions = options;
+  if (madInitted) mad_stream_options(stream, madOptions);
+}
 
 bool AudioGeneratorMP3::begin(AudioFileSource *source, AudioOutput *output)
 {
@@ -282,13 +435,20 @@ bool AudioGeneratorMP3::begin(AudioFileSource *source, AudioOutput *output)
 
   if (!output->begin()) return false;
 
-  // Where we are in generating one frame's data, set to invalid so we will run loop on first getsample()
-  samplePtr = 9999;
+  // Where we are in generating one frame's data, set to invalid so the first loop() decodes a frame
+  pcmPtr = 0;
+  pcmLen = 0;
   nsCount = 9999;
   lastRate = 0;
   lastChannels = 0;
   lastReadPos = 0;
   lastBuffLen = 0;
+  mapped = file->getMapped();
+  mappedLen = mapped ? file->getSize() : 0;
+  guardAdded = false;
+  gaplessChecked = false;
+  gaplessSkip = 0;
+  gaplessLeft = UINT32_MAX;
 
   // Allocate all large memory chunks
   if (preallocateStreamSize + preallocateFrameSize + preallocateSynthSize) {
@@ -349,7 +509,7 @@ bool AudioGeneratorMP3::begin(AudioFileSource *source, AudioOutput *output)
   mad_frame_init(frame);
   mad_synth_init(synth);
   synth->pcm.length = 0;
-  mad_stream_options(stream, 0); // TODO - add options support
+  mad_stream_options(stream, madOptions);
   madInitted = true;
 
   running = true;
@@ -37,6 +37,10 @@ class AudioGeneratorMP3 : public AudioGenerator
     virtual bool stop() override;
     virtual bool isRunning() override;
     virtual void desync () override;
+    bool prime(); // Decode the first frame ahead of time, e.g. while another generator is still playing
+    // libmad MAD_OPTION_* flags, e.g. MAD_OPTION_SINGLECHANNEL to synthesize one downmixed channel or
+    // MAD_OPTION_HALFSAMPLERATE to synthesize at half rate.  Takes effect from the next frame.
+    void SetDecodeOptions(int options);
 
     static constexpr int preAllocSize () { return preAllocBuffSize() + preAllocStreamSize() + preAllocFrameSize() + preAllocSynthSize(); }
     static constexpr int preAllocBuffSize () { return ((buffLen + 7) & ~7); }
@@ -58,6 +62,9 @@ class AudioGeneratorMP3 : public AudioGenerator
     unsigned char *buff;
     int lastReadPos;
     int lastBuffLen;
+    const uint8_t *mapped; // Source is addressable, decode straight from it instead of copying into buff
+    int mappedLen;
+    bool guardAdded; // Zeros appended after the last frame, which libmad needs to decode it
     unsigned int lastRate;
     int lastChannels;
     
@@ -66,15 +73,27 @@ class AudioGeneratorMP3 : public AudioGenerator
     struct mad_stream *stream;
     struct mad_frame *frame;
     struct mad_synth *synth;
-    int samplePtr;
     int nsCount;
     int nsCountMax;
+    int madOptions;
+
+    // Interleaved PCM for a few granules, handed to the output in one ConsumeSamples() call
+    static constexpr int pcmBlockFrames = 128;
+    int16_t pcmBlock[pcmBlockFrames * 2];
+    int pcmPtr;
+    int pcmLen;
+
+    // Gapless playback from a LAME/Xing/Info tag: encoder delay and padding are dropped
+    bool gaplessChecked;
+    int gaplessSkip;        // Samples still to drop at the start
+    uint32_t gaplessLeft;   // Samples still to output, UINT32_MAX without a frame count
 
     // The internal helpers
     enum mad_flow ErrorToFlow();
     enum mad_flow Input();
     bool DecodeNextFrame();
-    bool GetOneSample(int16_t sample[2]);
+    bool ParseGaplessInfo();
+    bool FillBlock();
 
   private:
     int unrecoverable = 0;
@@ -0,0 +1,188 @@
+/*
+  AudioGeneratorSILK
+  Audio output generator for raw SILK-only Opus packets, decoded
+  without the CELT layer
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "AudioGeneratorSILK.h"
+extern "C" {
+  #include "libopus/silk/API.h"
+};
+
+AudioGeneratorSILK::AudioGeneratorSILK()
+{
+  running = false;
+  file = NULL;
+  output = NULL;
+  work = NULL;
+  workBytes = 0;
+  silkDec = NULL;
+  packet = NULL;
+  packetLen = 0;
+  pcm = NULL;
+  pcmPtr = 0;
+  pcmLen = 0;
+}
+
+AudioGeneratorSILK::~AudioGeneratorSILK()
+{
+  free(work);
+}
+
+bool AudioGeneratorSILK::stop()
+{
+  if (!running) return true;
+  running = false;
+  output->stop();
+  return file->close();
+}
+
+bool AudioGeneratorSILK::isRunning()
+{
+  return running;
+}
+
+bool AudioGeneratorSILK::ReadPacket()
+{
+  uint8_t len[2];
+  if (file->read(len, 2) != 2) return false;
+  packetLen = len[0] | (len[1] << 8);
+  if (packetLen > maxPacketBytes) {
+    audioLogger->printf_P(PSTR("AudioGeneratorSILK: %d-byte packet, not a packet stream\n"), packetLen);
+    return false;
+  }
+  return (int)file->read(packet, packetLen) == packetLen;
+}
+
+// What opus_decode_frame() does for a SILK-only frame, minus the CELT side:
+// one range decoder per frame, 20 ms of SILK per silk_Decode() call.
+int AudioGeneratorSILK::DecodeSILK(const unsigned char *frames[], const opus_int16 sizes[], int count, int16_t *mono)
+{
+  static const opus_int32 internalRate[3] = {8000, 12000, 16000}; // NB, MB, WB
+  const int config = packet[0] >> 3;
+  const int frameMs = (config & 3) ? (config & 3) * 20 : 10;
+  const int frameSamples = sampleRate * frameMs / 1000;
+  if (count * frameSamples > maxPacketSamples) return OPUS_BUFFER_TOO_SMALL;
+
+  silk_DecControlStruct ctl;
+  ctl.nChannelsAPI = 1;
+  ctl.nChannelsInternal = (packet[0] & 4) ? 2 : 1;
+  ctl.API_sampleRate = sampleRate;
+  ctl.internalSampleRate = internalRate[config >> 2];
+  ctl.payloadSize_ms = frameMs;
+  for (int f = 0; f < count; f++) {
+    ec_dec dec;
+    ec_dec_init(&dec, const_cast<unsigned char*>(frames[f]), sizes[f]);
+    int decoded = 0;
+    while (decoded < frameSamples) {
+      opus_int32 n = 0;
+      if (silk_Decode(silkDec, &ctl, 0, decoded == 0, &dec, mono + decoded, &n, 0) != 0) return OPUS_INVALID_PACKET;
+      decoded += n;
+    }
+    mono += frameSamples;
+  }
+  return count * frameSamples;
+}
+
+bool AudioGeneratorSILK::DecodePacket()
+{
+  // Decode into the back half, then spread each sample to both channels front to back
+  int16_t *mono = &pcm[0][0] + maxPacketSamples;
+  const unsigned char *frames[48];
+  opus_int16 sizes[48];
+  int n = opus_packet_parse(packet, packetLen, NULL, frames, sizes, NULL);
+  if (n > 0 && (packet[0] >> 3) >= 12) {
+    audioLogger->printf_P(PSTR("AudioGeneratorSILK: TOC config %d needs CELT, not supported\n"), packet[0] >> 3);
+    return false;
+  }
+  if (n > 0) n = DecodeSILK(frames, sizes, n, mono);
+  if (n < 0) {
+    // Error, skip the packet...
+    char buff[48];
+    sprintf_P(buff, PSTR("Opus decode error %d"), n);
+    cb.st(n, buff);
+    n = 0;
+  }
+  for (int i = 0; i < n; i++) {
+    const int16_t s = mono[i];
+    pcm[i][AudioOutput::LEFTCHANNEL] = s;
+    pcm[i][AudioOutput::RIGHTCHANNEL] = s;
+  }
+  pcmPtr = 0;
+  pcmLen = n;
+  return true;
+}
+
+bool AudioGeneratorSILK::loop()
+{
+  if (!running) goto done; // Nothing to do here!
+
+  while (running) {
+    // Hand the rest of the packet to the output.  If it can't take it all, punt and try later
+    if (pcmPtr < pcmLen) {
+      pcmPtr += output->ConsumeSamples(&pcm[pcmPtr][0], pcmLen - pcmPtr);
+      if (pcmPtr < pcmLen) goto done; // Can't send, but no error detected
+    }
+    if (!ReadPacket() || !DecodePacket()) return false; // End of data, the caller stops us
+  }
+
+done:
+  file->loop();
+  output->loop();
+
+  return running;
+}
+
+bool AudioGeneratorSILK::begin(AudioFileSource *source, AudioOutput *output)
+{
+  if (!source || !output) return false;
+  file = source;
+  this->output = output;
+  if (!file->isOpen()) {
+    audioLogger->printf_P(PSTR("AudioGeneratorSILK::begin: file not open\n"));
+    return false;
+  }
+
+  if (!work) {
+    int silkBytes = 0;
+    silk_Get_Decoder_Size(&silkBytes);
+    silkBytes = (silkBytes + 7) & ~7;
+    const int packetBytes = (maxPacketBytes + 7) & ~7;
+    workBytes = silkBytes + packetBytes + maxPacketSamples * 2 * sizeof(int16_t);
+    work = malloc(workBytes);
+    if (!work) {
+      audioLogger->printf_P(PSTR("AudioGeneratorSILK::begin: out of memory\n"));
+      workBytes = 0;
+      return false;
+    }
+    silkDec = work;
+    packet = (uint8_t*)work + silkBytes;
+    pcm = (int16_t(*)[2])(packet + packetBytes);
+  }
+  // Every stream starts from a clean decoder
+  silk_InitDecoder(silkDec);
+  pcmPtr = 0;
+  pcmLen = 0;
+
+  if (!output->SetRate(sampleRate) || !output->SetBitsPerSample(16) || !output->SetChannels(1)) {
+    audioLogger->printf_P(PSTR("AudioGeneratorSILK::begin: output rejected the format\n"));
+    return false;
+  }
+  if (!output->begin()) return false;
+
+  running = true;
+  return true;
+}
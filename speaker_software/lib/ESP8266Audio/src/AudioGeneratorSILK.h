@@ -0,0 +1,68 @@
+/*
+  AudioGeneratorSILK
+  Audio output generator for raw Opus packets, SILK-only ones decoded
+  without the CELT layer
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _AUDIOGENERATORSILK_H
+#define _AUDIOGENERATORSILK_H
+
+#include "AudioGenerator.h"
+#include "libopus/opus.h"
+
+// Reads a stream of Opus packets, each behind a 2-byte little-endian length,
+// and plays it mono at 16 kHz. There is no Ogg layer and no header. Every
+// packet must be SILK-only (TOC config 0-11): its frames go straight to the
+// SILK decoder, with the same output as opus_decode()'s. No CELT state is set
+// up and no CELT code runs; libopus builds with VAR_ARRAYS, and a CELT frame
+// would put its scratch arrays on the decoding task's stack. A hybrid or CELT
+// packet ends the stream.
+// The SILK state and the buffers are allocated by the first begin() and kept.
+class AudioGeneratorSILK : public AudioGenerator
+{
+  public:
+    AudioGeneratorSILK();
+    virtual ~AudioGeneratorSILK() override;
+    virtual bool begin(AudioFileSource *source, AudioOutput *output) override;
+    virtual bool loop() override;
+    virtual bool stop() override;
+    virtual bool isRunning() override;
+
+    // Heap the generator holds once begun
+    int getStateBytes() const { return workBytes; }
+
+    static constexpr int sampleRate = 16000;
+    static constexpr int maxPacketBytes = 1275;
+    static constexpr int maxPacketSamples = sampleRate * 60 / 1000;
+
+  private:
+    bool ReadPacket();
+    int DecodeSILK(const unsigned char *frames[], const opus_int16 sizes[], int count, int16_t *mono);
+    bool DecodePacket();
+
+  protected:
+    void *work;       // SILK decoder state, then packet and pcm
+    int workBytes;
+    void *silkDec;
+    uint8_t *packet;
+    int packetLen;
+    int16_t (*pcm)[2];
+    int pcmPtr;
+    int pcmLen;
+};
+
+#endif
+
@@ -41,6 +41,15 @@ AudioOutputI2S::AudioOutputI2S(int port, int output_mode, int dma_buf_count, int
   this->use_apll = use_apll;
 
   //set defaults
+  sessionHold = false;
+  writeTicks = 0;
+  dmaEvents = false;
+  monoFrames = false;
+  queuedFrames = 0;
+  ResetDmaStats();
+#ifdef ESP32
+  eventQueue = NULL;
+#endif
   mono = false;
   lsb_justified = false;
   bps = 16;
@@ -56,6 +65,12 @@ AudioOutputI2S::AudioOutputI2S(int port, int output_mode, int dma_buf_count, int
 #elif defined(ARDUINO_ARCH_RP2040)
 AudioOutputI2S::AudioOutputI2S(long sampleRate, pin_size_t sck, pin_size_t data) {
     i2sOn = false;
+    sessionHold = false;
+    writeTicks = 0;
+    dmaEvents = false;
+    monoFrames = false;
+    queuedFrames = 0;
+    ResetDmaStats();
     mono = false;
     bps = 16;
     channels = 2;
@@ -71,6 +86,7 @@ AudioOutputI2S::AudioOutputI2S(long sampleRate, pin_size_t sck, pin_size_t data)
 
 AudioOutputI2S::~AudioOutputI2S()
 {
+  sessionHold = false;
   stop();
 }
 
@@ -136,6 +152,8 @@ bool AudioOutputI2S::SetPinout(int bclk, int wclk, int dout, int mclk)
 bool AudioOutputI2S::SetRate(int hz)
 {
   // TODO - have a list of allowable rates from constructor, check them
+  if (i2sOn && sessionHold && (hz == this->hertz))
+    return true; // Reprogramming the clock mid-session would glitch the output
   this->hertz = hz;
   if (i2sOn)
   {
@@ -185,6 +203,88 @@ bool AudioOutputI2S::SwapClocks(bool swap_clocks)
   return true;
 }
 
+bool AudioOutputI2S::SetWriteTimeout(uint32_t ticks)
+{
+  this->writeTicks = ticks;
+  return true;
+}
+
+bool AudioOutputI2S::SetDmaEvents(bool enable)
+{
+  if (i2sOn) {
+    return false; // Only takes effect on driver install
+  }
+  #ifdef ESP32
+    this->dmaEvents = enable;
+    return true;
+  #else
+    (void)enable;
+    return false;
+  #endif
+}
+
+bool AudioOutputI2S::SetMonoFrames(bool enable)
+{
+  if (i2sOn) {
+    return false; // Frame format is fixed at driver install
+  }
+  #ifdef ESP32
+    if (output_mode != EXTERNAL_I2S) {
+      return false;
+    }
+    this->monoFrames = enable;
+    return true;
+  #else
+    (void)enable;
+    return false;
+  #endif
+}
+
+void AudioOutputI2S::ResetDmaStats()
+{
+  dmaStats.txDone = 0;
+  dmaStats.underflows = 0;
+  dmaStats.lowWater = 0xffffffff;
+  dmaStarted = false;
+}
+
+#ifdef ESP32
+void AudioOutputI2S::HandleDmaEvent(int type)
+{
+  if (!dmaStarted) return;  // Silence the driver sent while waiting for data
+  if (type == I2S_EVENT_TX_DONE) {
+    dmaStats.txDone++;
+    const bool wasAbove = (queuedFrames >= dmaBufLen);
+    queuedFrames = (queuedFrames > dmaBufLen) ? (queuedFrames - dmaBufLen) : 0;
+    if (queuedFrames < dmaStats.lowWater) dmaStats.lowWater = queuedFrames;
+    if (wasAbove && (queuedFrames < dmaBufLen)) cb.st(STATUS_DMA_LOWWATER, PSTR("DMA low water"));
+  } else if (type == I2S_EVENT_TX_Q_OVF) {
+    dmaStats.underflows++;
+    queuedFrames = 0;
+    cb.st(STATUS_DMA_UNDERFLOW, PSTR("DMA underflow"));
+  }
+}
+
+void AudioOutputI2S::PollDmaEvents()
+{
+  i2s_event_t evt;
+  while (eventQueue && (xQueueReceive(eventQueue, &evt, 0) == pdTRUE)) {
+    HandleDmaEvent(evt.type);
+  }
+}
+
+bool AudioOutputI2S::WaitDmaEvent(uint32_t ticks)
+{
+  // Sleep until the DMA engine hands a buffer back
+  i2s_event_t evt;
+  while (eventQueue && (xQueueReceive(eventQueue, &evt, ticks) == pdTRUE)) {
+    HandleDmaEvent(evt.type);
+    if (evt.type == I2S_EVENT_TX_DONE) return true;
+  }
+  return false;
+}
+#endif
+
 bool AudioOutputI2S::SetMclk(bool enabled){
   (void)enabled;
   #ifdef ESP32
@@ -261,11 +361,11 @@ bool AudioOutputI2S::begin(bool txDAC)
           .mode = mode,
           .sample_rate = 44100,
           .bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT,
-          .channel_format = I2S_CHANNEL_FMT_RIGHT_LEFT,
+          .channel_format = monoFrames ? I2S_CHANNEL_FMT_ONLY_LEFT : I2S_CHANNEL_FMT_RIGHT_LEFT,
           .communication_format = comm_fmt,
           .intr_alloc_flags = ESP_INTR_FLAG_LEVEL1, // lowest interrupt priority
           .dma_buf_count = dma_buf_count,
-          .dma_buf_len = 128,
+          .dma_buf_len = dmaBufLen,
           .use_apll = use_apll, // Use audio PLL
           .tx_desc_auto_clear = true, // Silence on underflow
           .fixed_mclk = use_mclk, // Unused
@@ -275,7 +375,9 @@ bool AudioOutputI2S::begin(bool txDAC)
 #endif
       };
       audioLogger->printf("+%d %p\n", portNo, &i2s_config_dac);
-      if (i2s_driver_install((i2s_port_t)portNo, &i2s_config_dac, 0, NULL) != ESP_OK)
+      eventQueue = NULL;
+      queuedFrames = 0;
+      if (i2s_driver_install((i2s_port_t)portNo, &i2s_config_dac, dmaEvents ? 2 * dma_buf_count : 0, dmaEvents ? &eventQueue : NULL) != ESP_OK)
       {
         audioLogger->println("ERROR: Unable to install I2S drives\n");
       }
@@ -349,6 +451,11 @@ bool AudioOutputI2S::ConsumeSample(int16_t sample[2])
     ms[LEFTCHANNEL] = ms[RIGHTCHANNEL] = (ttl>>1) & 0xffff;
   }
   #ifdef ESP32
+    if (monoFrames)
+    {
+      int16_t m = Amplify(this->mono ? ms[LEFTCHANNEL] : ((ms[LEFTCHANNEL] + ms[RIGHTCHANNEL])>>1));
+      return WriteFrames(&m, 1) == 1;
+    }
     uint32_t s32;
     if (output_mode == INTERNAL_DAC)
     {
@@ -364,7 +471,11 @@ bool AudioOutputI2S::ConsumeSample(int16_t sample[2])
 //    return i2s_write_bytes((i2s_port_t)portNo, (const char *)&s32, sizeof(uint32_t), 0);
 
     size_t i2s_bytes_written;
-    i2s_write((i2s_port_t)portNo, (const char*)&s32, sizeof(uint32_t), &i2s_bytes_written, 0);
+    i2s_write((i2s_port_t)portNo, (const char*)&s32, sizeof(uint32_t), &i2s_bytes_written, writeTicks);
+    if (eventQueue) {
+      PollDmaEvents();
+      queuedFrames += i2s_bytes_written / sizeof(uint32_t);
+    }
     return i2s_bytes_written;
   #elif defined(ESP8266)
     uint32_t s32 = ((Amplify(ms[RIGHTCHANNEL])) << 16) | (Amplify(ms[LEFTCHANNEL]) & 0xffff);
@@ -375,11 +486,126 @@ bool AudioOutputI2S::ConsumeSample(int16_t sample[2])
   #endif
 }
 
+uint16_t AudioOutputI2S::ConsumeSamples(int16_t *samples, uint16_t count)
+{
+  #ifdef ESP32
+    if (!i2sOn)
+      return 0;
+    if (output_mode == INTERNAL_DAC)
+      return AudioOutput::ConsumeSamples(samples, count);
+
+    // Convert a block at a time and hand it to the driver in one i2s_write() instead of one per frame
+    static constexpr uint16_t blockFrames = 128;
+    uint32_t block[blockFrames];
+    int16_t *monoBlock = reinterpret_cast<int16_t*>(block);
+    const bool dupLeft = (channels == 1);
+    const bool from8 = (bps == 8);
+    const bool avg = this->mono;
+    uint16_t done = 0;
+    while (done < count) {
+      uint16_t n = count - done;
+      if (n > blockFrames) n = blockFrames;
+      const int16_t *s = samples + 2 * done;
+      for (uint16_t i = 0; i < n; i++, s += 2) {
+        int16_t l = s[LEFTCHANNEL];
+        int16_t r = dupLeft ? l : s[RIGHTCHANNEL];
+        if (from8) {
+          l = (((int16_t)(l&0xff)) - 128) << 8;
+          r = (((int16_t)(r&0xff)) - 128) << 8;
+        }
+        if (monoFrames) {
+          monoBlock[i] = Amplify(dupLeft ? l : ((l + r)>>1));
+          continue;
+        }
+        if (avg) {
+          l = r = ((l + r)>>1) & 0xffff;
+        }
+        block[i] = ((Amplify(r)) << 16) | (Amplify(l) & 0xffff);
+      }
+      const uint16_t written = WriteFrames(block, n);
+      done += written;
+      if (written < n)
+        break; // DMA full, caller retries the rest later
+    }
+    return done;
+  #else
+    return AudioOutput::ConsumeSamples(samples, count);
+  #endif
+}
+
+uint16_t AudioOutputI2S::ConsumeMonoSamples(const int16_t *samples, uint16_t count)
+{
+  #ifdef ESP32
+    if (i2sOn && monoFrames) {
+      static constexpr uint16_t blockFrames = 256;
+      int16_t block[blockFrames];
+      uint16_t done = 0;
+      while (done < count) {
+        uint16_t n = count - done;
+        if (n > blockFrames) n = blockFrames;
+        for (uint16_t i = 0; i < n; i++)
+          block[i] = Amplify(samples[done + i]);
+        const uint16_t written = WriteFrames(block, n);
+        done += written;
+        if (written < n)
+          break;
+      }
+      return done;
+    }
+  #endif
+  // Duplicate into stereo frames for every other output format
+  uint16_t done = 0;
+  while (done < count) {
+    int16_t ms[2] = { samples[done], samples[done] };
+    if (!ConsumeSample(ms))
+      break;
+    done++;
+  }
+  return done;
+}
+
+#ifdef ESP32
+uint16_t AudioOutputI2S::WriteFrames(const void *frames, uint16_t count)
+{
+  // With DMA events, write without blocking and sleep on TX_DONE until the whole block is queued
+  const size_t frameBytes = monoFrames ? sizeof(int16_t) : sizeof(uint32_t);
+  const size_t bytes = count * frameBytes;
+  const bool waitEvents = (eventQueue != NULL) && (writeTicks != 0);
+  if (eventQueue)
+    PollDmaEvents();
+  size_t off = 0;
+  while (true) {
+    size_t i2s_bytes_written = 0;
+    i2s_write((i2s_port_t)portNo, (const char*)frames + off, bytes - off, &i2s_bytes_written, waitEvents ? 0 : writeTicks);
+    off += i2s_bytes_written;
+    if (i2s_bytes_written)
+      dmaStarted = true;
+    if ((off >= bytes) || !waitEvents || !WaitDmaEvent(writeTicks))
+      break;
+  }
+  const uint16_t written = off / frameBytes;
+  if (eventQueue)
+    queuedFrames += written;
+  return written;
+}
+#endif
+
 void AudioOutputI2S::flush()
 {
   #ifdef ESP32
+    if (eventQueue) {
+      // Every buffer still holding samples goes out within dma_buf_count periods, tx_desc_auto_clear
+      // refills them with silence.  Count completions instead of pushing zeros and sleeping.
+      PollDmaEvents();
+      const uint32_t periodMs = (dmaBufLen * 1000) / (hertz ? hertz : 44100) + 1;
+      for (int i = 0; i < dma_buf_count; i++) {
+        if (!WaitDmaEvent(pdMS_TO_TICKS(2 * periodMs) + 1))
+          break;
+      }
+      return;
+    }
     // makes sure that all stored DMA samples are consumed / played
-    int buffersize = 128 * this->dma_buf_count;
+    int buffersize = dmaBufLen * this->dma_buf_count;
     int16_t samples[2] = {0x0, 0x0};
     for (int i = 0; i < buffersize; i++)
     {
@@ -393,15 +619,37 @@ void AudioOutputI2S::flush()
   #endif
 }
 
+bool AudioOutputI2S::beginSession()
+{
+  if (!begin())
+    return false;
+  sessionHold = true;
+  return true;
+}
+
+bool AudioOutputI2S::endSession()
+{
+  if (!sessionHold)
+    return false;
+  sessionHold = false;
+  flush();
+  return stop();
+}
+
 bool AudioOutputI2S::stop()
 {
   if (!i2sOn)
     return false;
 
+  // Generators call stop() at the end of every file, keep the driver and DMA running between clips
+  if (sessionHold)
+    return true;
+
   #ifdef ESP32
     i2s_zero_dma_buffer((i2s_port_t)portNo);
     audioLogger->printf("UNINSTALL I2S\n");
     i2s_driver_uninstall((i2s_port_t)portNo); //stop & destroy i2s driver
+    eventQueue = NULL; // Deleted by the driver
   #elif defined(ESP8266)
     i2s_end();
   #elif defined(ARDUINO_ARCH_RP2040)
@@ -26,6 +26,10 @@
 #include <Arduino.h>
 #include <I2S.h>
 #endif
+#ifdef ESP32
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#endif
 
 class AudioOutputI2S : public AudioOutput
 {
@@ -45,14 +49,34 @@ class AudioOutputI2S : public AudioOutput
     virtual bool SetChannels(int channels) override;
     virtual bool begin() override { return begin(true); }
     virtual bool ConsumeSample(int16_t sample[2]) override;
+    virtual uint16_t ConsumeSamples(int16_t *samples, uint16_t count) override;
+    uint16_t ConsumeMonoSamples(const int16_t *samples, uint16_t count);  // One 16-bit sample per frame
     virtual void flush() override;
     virtual bool stop() override;
     
     bool begin(bool txDAC);
     bool SetOutputModeMono(bool mono);  // Force mono output no matter the input
+    bool SetMonoFrames(bool enable);  // ESP32: 16-bit single slot frames (I2S_CHANNEL_FMT_ONLY_LEFT), implies mono
+    bool GetMonoFrames() const { return monoFrames; }
     bool SetLsbJustified(bool lsbJustified);  // Allow supporting non-I2S chips, e.g. PT8211 
     bool SetMclk(bool enabled);  // Enable MCLK output (if supported)
     bool SwapClocks(bool swap_clocks);  // Swap BCLK and WCLK
+    bool beginSession();  // Keep the driver installed across stop() calls, e.g. for a playlist
+    bool endSession();  // Drain the DMA buffers and really stop
+    bool SetWriteTimeout(uint32_t ticks);  // ESP32: let writes block for free DMA space (RTOS ticks, 0=never)
+    bool SetDmaEvents(bool enable);  // ESP32: install the driver with an event queue, writes wait on TX_DONE
+
+    // DMA accounting, only maintained with SetDmaEvents(true).  Counting starts with the first
+    // frames written after ResetDmaStats(): the idle buffers before that are not underflows.
+    typedef struct {
+      uint32_t txDone;      // DMA buffers sent
+      uint32_t underflows;  // buffers that went out without fresh data (silence)
+      uint32_t lowWater;    // fewest frames queued when a buffer completed
+    } DmaStats;
+    DmaStats GetDmaStats() const { return dmaStats; }
+    void ResetDmaStats();
+
+    enum { STATUS_DMA_UNDERFLOW=2, STATUS_DMA_LOWWATER };
 
   protected:
     bool SetPinout();
@@ -66,6 +90,21 @@ class AudioOutputI2S : public AudioOutput
     int use_apll;
     bool use_mclk;
     bool swap_clocks;
+    bool sessionHold;
+    uint32_t writeTicks;
+    bool dmaEvents;
+    bool monoFrames;
+    DmaStats dmaStats;
+    bool dmaStarted;
+    uint32_t queuedFrames;
+#ifdef ESP32
+    static constexpr int dmaBufLen = 128;
+    QueueHandle_t eventQueue;
+    void PollDmaEvents();
+    bool WaitDmaEvent(uint32_t ticks);
+    void HandleDmaEvent(int type);
+    uint16_t WriteFrames(const void *frames, uint16_t count);
+#endif
     // We can restore the old values and free up these pins when in NoDAC mode
     uint32_t orig_bck;
     uint32_t orig_ws;
@@ -150,6 +150,17 @@ typedef struct _AACFrameInfo {
 
 typedef void *HAACDecoder;
 
+/* space AACInitDecoderPre() carves up, each part 8-byte aligned: AACDecInfo
+ * and PSInfoBase (checked in buffers.c), then PSInfoSBR (checked in sbr.c);
+ * 96 + 28752 and 50788 bytes on a 32-bit target */
+#define AAC_PREALLOC_BASE_SIZE	(29 * 1024)
+#ifndef ESP8266
+#define AAC_PREALLOC_SBR_SIZE	(50 * 1024)
+#else
+#define AAC_PREALLOC_SBR_SIZE	0
+#endif
+#define AAC_PREALLOC_SIZE	(AAC_PREALLOC_BASE_SIZE + AAC_PREALLOC_SBR_SIZE)
+
 /* public C API */
 HAACDecoder AACInitDecoder(void);
 HAACDecoder AACInitDecoderPre(void *ptr, int sz);
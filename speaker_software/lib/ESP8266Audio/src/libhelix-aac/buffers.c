@@ -113,6 +113,9 @@ AACDecInfo *AllocateBuffers(void)
 	return aacDecInfo;
 }
 
+_Static_assert(((sizeof(AACDecInfo) + 7) & ~7) + ((sizeof(PSInfoBase) + 7) & ~7) <= AAC_PREALLOC_BASE_SIZE,
+               "AAC_PREALLOC_BASE_SIZE too small");
+
 AACDecInfo *AllocateBuffersPre(void **ptr, int *sz)
 {
         AACDecInfo *aacDecInfo;
@@ -115,6 +115,8 @@ int InitSBR(AACDecInfo *aacDecInfo)
 	return ERR_AAC_NONE;
 }
 
+_Static_assert(sizeof(PSInfoSBR) <= AAC_PREALLOC_SBR_SIZE, "AAC_PREALLOC_SBR_SIZE too small");
+
 int InitSBRPre(AACDecInfo *aacDecInfo, void **ptr, int *sz)
 {
         PSInfoSBR *psi;
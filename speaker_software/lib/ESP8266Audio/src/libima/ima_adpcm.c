@@ -0,0 +1,90 @@
+/*
+  ima_adpcm
+  4-bit IMA/DVI ADPCM block codec, see ima_adpcm.h
+*/
+
+#include "ima_adpcm.h"
+
+static const int16_t stepTable[89] = {
+  7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+  50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+  253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+  1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+  3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+  11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+  32767
+};
+
+static const int8_t indexTable[16] = {
+  -1, -1, -1, -1, 2, 4, 6, 8,
+  -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+/* Applies one code to the predictor; encoder and decoder share it so they never drift apart. */
+static inline int step(int code, int *predictor, int *index)
+{
+  const int s = stepTable[*index];
+  int diff = s >> 3;
+  if (code & 4) diff += s;
+  if (code & 2) diff += s >> 1;
+  if (code & 1) diff += s >> 2;
+  int p = (code & 8) ? *predictor - diff : *predictor + diff;
+  if (p > 32767) p = 32767;
+  if (p < -32768) p = -32768;
+  *predictor = p;
+  int i = *index + indexTable[code];
+  if (i < 0) i = 0;
+  if (i > 88) i = 88;
+  *index = i;
+  return p;
+}
+
+int ima_adpcm_decode_block(const uint8_t *in, int bytes, int16_t *out, int max_samples)
+{
+  if (bytes < IMA_ADPCM_HEADER_BYTES || max_samples < 1 || in[2] > 88) return 0;
+  int predictor = (int16_t)(in[0] | (in[1] << 8));
+  int index = in[2];
+  int n = 0;
+  out[n++] = (int16_t)predictor;
+  for (int i = IMA_ADPCM_HEADER_BYTES; i < bytes && n < max_samples; i++) {
+    out[n++] = (int16_t)step(in[i] & 0x0f, &predictor, &index);
+    if (n < max_samples) out[n++] = (int16_t)step(in[i] >> 4, &predictor, &index);
+  }
+  return n;
+}
+
+int ima_adpcm_encode_block(const int16_t *in, int count, uint8_t *out, ima_adpcm_state *state)
+{
+  if (count < 1) return 0;
+  int predictor = in[0];
+  int index = state->index;
+  out[0] = (uint8_t)(predictor & 0xff);
+  out[1] = (uint8_t)((predictor >> 8) & 0xff);
+  out[2] = (uint8_t)index;
+  out[3] = 0;
+  int bytes = IMA_ADPCM_HEADER_BYTES;
+  for (int i = 1; i < count; i += 2) {
+    uint8_t b = 0;
+    for (int half = 0; half < 2; half++) {
+      if (i + half >= count) break;
+      int diff = in[i + half] - predictor;
+      int code = 0;
+      if (diff < 0) {
+        code = 8;
+        diff = -diff;
+      }
+      int s = stepTable[index];
+      if (diff >= s) { code |= 4; diff -= s; }
+      s >>= 1;
+      if (diff >= s) { code |= 2; diff -= s; }
+      s >>= 1;
+      if (diff >= s) code |= 1;
+      step(code, &predictor, &index);
+      b |= (uint8_t)(code << (4 * half));
+    }
+    out[bytes++] = b;
+  }
+  state->predictor = (int16_t)predictor;
+  state->index = (uint8_t)index;
+  return bytes;
+}
@@ -0,0 +1,44 @@
+/*
+  ima_adpcm
+  4-bit IMA/DVI ADPCM, mono, in the block layout of WAV format 0x0011:
+  a 4-byte header (first sample, step index, 0) followed by two samples
+  per byte, low nibble first. Shared by AudioGeneratorADPCM and the host
+  voice pack compiler.
+*/
+
+#ifndef _IMA_ADPCM_H
+#define _IMA_ADPCM_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define IMA_ADPCM_HEADER_BYTES 4
+
+/* Encoder state carried from one block to the next. */
+typedef struct {
+  int16_t predictor;
+  uint8_t index;
+} ima_adpcm_state;
+
+/* Samples held by a block of the given size (the header counts as one). */
+static inline int ima_adpcm_block_samples(int bytes)
+{
+  return (bytes > IMA_ADPCM_HEADER_BYTES) ? 1 + 2 * (bytes - IMA_ADPCM_HEADER_BYTES) : (bytes == IMA_ADPCM_HEADER_BYTES);
+}
+
+/* Decodes one block into at most max_samples samples. Returns the number
+   written, 0 if the header is invalid. */
+int ima_adpcm_decode_block(const uint8_t *in, int bytes, int16_t *out, int max_samples);
+
+/* Encodes count samples into one block; out must hold
+   IMA_ADPCM_HEADER_BYTES + count / 2 bytes. Returns the bytes used. */
+int ima_adpcm_encode_block(const int16_t *in, int count, uint8_t *out, ima_adpcm_state *state);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
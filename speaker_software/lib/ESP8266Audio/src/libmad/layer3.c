@@ -2502,6 +2502,12 @@ enum mad_error III_decode(struct mad_bitptr *ptr, struct mad_frame *frame,
       unsigned int sb, l, i, sblimit;
       mad_fixed_t output[36];
 
+      /* the synthesis will only look at the selected channel */
+      if (nch == 2 &&
+	  (frame->options & MAD_OPTION_SINGLECHANNEL) ==
+	  (ch ? MAD_OPTION_LEFTCHANNEL : MAD_OPTION_RIGHTCHANNEL))
+	continue;
+
       if (channel->block_type == 2) {
         error = III_reorder(xr[ch], channel, sfbwidth[ch], frame->tmp);
         if (error) {
@@ -866,6 +866,46 @@ enum mad_flow synth_half(struct mad_synth *synth, struct mad_frame const *frame,
   return MAD_FLOW_CONTINUE;
 }
 
+/*
+   NAME:	synth->select()
+   DESCRIPTION:	apply MAD_OPTION_*CHANNEL to a stereo frame, returns the
+		number of channels left to synthesize
+*/
+static
+unsigned int synth_select(struct mad_frame const *frame, unsigned int nch,
+			  unsigned int s0, unsigned int s1)
+{
+  int const select = frame->options & MAD_OPTION_SINGLECHANNEL;
+  mad_fixed_t (*sbsample)[36][32];
+  unsigned int s, sb;
+
+  if (nch != 2 || select == 0)
+    return nch;
+
+  /*
+   * The polyphase filterbank is linear, so mixing (or moving) the subband
+   * samples into channel 0 and running one synthesis pass gives the same
+   * PCM as synthesizing both channels and mixing afterwards.  The frame is
+   * scratch space owned by the caller at this point.
+   */
+  sbsample = ((struct mad_frame *) frame)->sbsample;
+
+  for (s = s0; s < s1; ++s) {
+    for (sb = 0; sb < 32; ++sb) {
+      switch (select) {
+      case MAD_OPTION_RIGHTCHANNEL:
+	sbsample[0][s][sb] = sbsample[1][s][sb];
+	break;
+      case MAD_OPTION_SINGLECHANNEL:
+	sbsample[0][s][sb] = (sbsample[0][s][sb] >> 1) + (sbsample[1][s][sb] >> 1);
+	break;
+      }
+    }
+  }
+
+  return 1;
+}
+
 /*
    NAME:	synth->frame()
    DESCRIPTION:	perform PCM synthesis of frame subband samples
@@ -878,6 +918,7 @@ enum mad_flow mad_synth_frame(struct mad_synth *synth, struct mad_frame const *f
 
   nch = MAD_NCHANNELS(&frame->header);
   ns  = MAD_NSBSAMPLES(&frame->header);
+  nch = synth_select(frame, nch, 0, ns);
 
   synth->pcm.samplerate = frame->header.samplerate;
   synth->pcm.channels   = nch;
@@ -908,6 +949,7 @@ enum mad_flow mad_synth_frame_onens(struct mad_synth *synth, struct mad_frame co
 
   nch = MAD_NCHANNELS(&frame->header);
 //  ns  = MAD_NSBSAMPLES(&frame->header);
+  nch = synth_select(frame, nch, ns, ns + 1);
 
   synth->pcm.samplerate = frame->header.samplerate;
   synth->pcm.channels   = nch;
@@ -24,7 +24,7 @@
    NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
-#if 0
+#ifdef OPUS_HOST_ENCODER // the firmware only decodes; tools/voice_pack encodes
 //#ifdef HAVE_CONFIG_H
 #include "config.h"
 //#endif
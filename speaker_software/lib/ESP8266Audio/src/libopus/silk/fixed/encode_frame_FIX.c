@@ -34,7 +34,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "../../celt/stack_alloc.h"
 #include "../tuning_parameters.h"
 
-#if 0
+#ifdef OPUS_HOST_ENCODER // the firmware only decodes; tools/voice_pack encodes
 /* Low Bitrate Redundancy (LBRR) encoding. Reuse all parameters but encode with lower bitrate           */
 static OPUS_INLINE void silk_LBRR_encode_FIX(
     silk_encoder_state_FIX          *psEnc,                                 /* I/O  Pointer to Silk FIX encoder state                                           */
@@ -0,0 +1,444 @@
+#include "announcement_player.h"
+
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+#include <math.h>
+#include <string.h>
+
+#include "asset_index.h"
+#include "output_wait.h"
+#include "project_config.h"
+
+#if ENABLE_SERIAL_DEBUG
+#define DBG_PRINT(...) Serial.print(__VA_ARGS__)
+#define DBG_PRINTLN(...) Serial.println(__VA_ARGS__)
+#else
+#define DBG_PRINT(...)
+#define DBG_PRINTLN(...)
+#endif
+
+namespace {
+// Seeks past an ID3v2 tag using only its 10-byte header instead of
+// parsing the frames byte by byte.
+bool skip_id3(AudioFileSource& src) {
+  uint8_t hdr[10];
+  if (src.read(hdr, sizeof(hdr)) != sizeof(hdr)) return false;
+  return src.seek(static_cast<int32_t>(id3_tag_size(hdr)), SEEK_SET);
+}
+
+bool is_m4a(const char* path) {
+  const size_t len = strlen(path);
+  return len > 4 && strcasecmp(path + len - 4, ".m4a") == 0;
+}
+} // namespace
+
+AnnouncementPlayer::AnnouncementPlayer(fs::FS& fs)
+    : fs_(fs), slots_{Slot(fs, arenas_[0]), Slot(fs, arenas_[1])} {
+  // The output is mono, so stereo clips are mixed down before synthesis.
+  const int options = MAD_OPTION_SINGLECHANNEL | (kMp3HalfSampleRate ? MAD_OPTION_HALFSAMPLERATE : 0);
+  for (Slot& slot : slots_) {
+    slot.mp3.SetDecodeOptions(options);
+    slot.out.set_target(&tee_);
+  }
+  xfade_.set_window_ms(kCrossfadeMs);
+}
+
+void AnnouncementPlayer::SlotOutput::reset() {
+  live_ = false;
+  hertz = 0;
+  bps = 0;
+  channels = 0;
+}
+
+bool AnnouncementPlayer::SlotOutput::go_live() {
+  live_ = true;
+  if (hertz && !out_->SetRate(hertz)) return false;
+  if (bps && !out_->SetBitsPerSample(bps)) return false;
+  if (channels && !out_->SetChannels(channels)) return false;
+  return true;
+}
+
+bool AnnouncementPlayer::SlotOutput::SetRate(int hz) {
+  hertz = hz;
+  return live_ ? out_->SetRate(hz) : true;
+}
+
+bool AnnouncementPlayer::SlotOutput::SetBitsPerSample(int bits) {
+  bps = bits;
+  return live_ ? out_->SetBitsPerSample(bits) : true;
+}
+
+bool AnnouncementPlayer::SlotOutput::SetChannels(int chan) {
+  channels = chan;
+  return live_ ? out_->SetChannels(chan) : true;
+}
+
+bool AnnouncementPlayer::CaptureOutput::SetRate(int hz) {
+  hertz = hz;
+  return out_->SetRate(hz);
+}
+
+bool AnnouncementPlayer::CaptureOutput::SetBitsPerSample(int bits) {
+  bps = bits;
+  return out_->SetBitsPerSample(bits);
+}
+
+bool AnnouncementPlayer::CaptureOutput::SetChannels(int chan) {
+  channels = chan;
+  return out_->SetChannels(chan);
+}
+
+void AnnouncementPlayer::CaptureOutput::begin_clip(uint32_t skip, uint32_t samples, bool measure) {
+  skip_ = samples ? skip : 0;
+  limit_ = samples;
+  pos_ = 0;
+  measure_ = measure;
+  first_ = UINT32_MAX;
+  last_ = 0;
+  memset(bin_power_, 0, sizeof(bin_power_));
+  memset(bin_blocks_, 0, sizeof(bin_blocks_));
+  block_sum_ = 0;
+  block_len_ = 0;
+}
+
+void AnnouncementPlayer::CaptureOutput::end_block() {
+  const float power = static_cast<float>(block_sum_) / block_len_;
+  block_sum_ = 0;
+  block_len_ = 0;
+  if (power <= 0.0f) return;
+  const int bin = static_cast<int>(floorf(10.0f * log10f(power / (32768.0f * 32768.0f)))) + kLevelBins;
+  if (bin < 0) return; // below the -60 dBFS absolute gate
+  const int b = bin < kLevelBins ? bin : kLevelBins - 1;
+  bin_power_[b] += power;
+  if (bin_blocks_[b] < UINT16_MAX) ++bin_blocks_[b];
+}
+
+uint16_t AnnouncementPlayer::CaptureOutput::measured_gain() const {
+  float sum = 0.0f;
+  uint32_t blocks = 0;
+  for (int b = 0; b < kLevelBins; ++b) {
+    sum += bin_power_[b];
+    blocks += bin_blocks_[b];
+  }
+  if (blocks == 0) return kVoicePackUnityGain;
+  // Relative gate: blocks more than 10 dB below the mean are left out.
+  const int gate = static_cast<int>(floorf(10.0f * log10f(sum / blocks / (32768.0f * 32768.0f)))) - 10 + kLevelBins;
+  sum = 0.0f;
+  blocks = 0;
+  for (int b = gate > 0 ? gate : 0; b < kLevelBins; ++b) {
+    sum += bin_power_[b];
+    blocks += bin_blocks_[b];
+  }
+  if (blocks == 0) return kVoicePackUnityGain;
+  const float loudness_db = 10.0f * log10f(sum / blocks / (32768.0f * 32768.0f));
+  const float db = kVoicePackLoudnessDb - loudness_db;
+  if (db >= 0.0f) return kVoicePackUnityGain;
+  return static_cast<uint16_t>(lroundf(kVoicePackUnityGain * powf(10.0f, db / 20.0f)));
+}
+
+bool AnnouncementPlayer::CaptureOutput::measured(uint32_t pad, uint32_t* skip, uint32_t* samples) const {
+  if (first_ == UINT32_MAX) return false;
+  *skip = first_ > pad ? first_ - pad : 0;
+  const uint32_t end = (last_ + 1 + pad < pos_) ? last_ + 1 + pad : pos_;
+  *samples = end - *skip;
+  return true;
+}
+
+uint16_t AnnouncementPlayer::CaptureOutput::ConsumeSamples(int16_t* samples, uint16_t count) {
+  // Past the window nothing is taken, so the generator's loop() returns and
+  // the player stops it before it decodes another frame.
+  if (clip_done()) return 0;
+  uint16_t done = 0;
+  if (pos_ < skip_) {
+    done = (skip_ - pos_ < count) ? static_cast<uint16_t>(skip_ - pos_) : count;
+    pos_ += done;
+  }
+  uint16_t n = count - done;
+  if (limit_ != 0 && skip_ + limit_ - pos_ < n) n = static_cast<uint16_t>(skip_ + limit_ - pos_);
+  int16_t* s = samples + 2 * done;
+  const uint16_t sent = n ? out_->ConsumeSamples(s, n) : 0;
+  if (cache_) cache_->capture(s, sent);
+  if (measure_) {
+    const uint32_t block_frames = static_cast<uint32_t>(hertz) / 50;
+    for (uint16_t k = 0; k < sent; ++k) {
+      const int32_t v = s[2 * k];
+      if (abs(v) > kTrimThreshold) {
+        if (first_ == UINT32_MAX) first_ = pos_ + k;
+        last_ = pos_ + k;
+      }
+      block_sum_ += static_cast<uint64_t>(v * v);
+      if (++block_len_ >= block_frames) end_block();
+    }
+  }
+  pos_ += sent;
+  done += sent;
+  return done;
+}
+
+bool AnnouncementPlayer::add_voice_pack(VoicePack* pack) {
+  if (!pack || !pack->is_open()) return false;
+  for (VoicePack*& p : packs_) {
+    if (!p) {
+      p = pack;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool AnnouncementPlayer::prime(Slot& slot, const char* path) {
+  slot.ready = false;
+  slot.cached = false;
+  if (!path || !out_) return false;
+  if (cache_ && cache_->contains(path)) {
+    slot.gain = clip_gain(path);
+    slot.cached = true;
+    slot.ready = true;
+    return true;
+  }
+  return open_clip(slot, path);
+}
+
+AudioFileSource* AnnouncementPlayer::open_source(Slot& slot, const char* path) {
+  // A voice pack holds all clips of a language behind one open handle.
+  VoicePackEntry entry{};
+  for (VoicePack* pack : packs_) {
+    if (pack && pack->find(path, &entry) && slot.pack_src.begin(pack, entry)) {
+      slot.gen = generator_for(slot, pack->codec());
+      if (!slot.gen) {
+        slot.pack_src.close();
+        return nullptr;
+      }
+      const bool mp3 = pack->codec() == VoicePackCodec::kMp3;
+      // The packer counts samples at the clip rate; half-rate synthesis yields half as many.
+      const bool half = mp3 && kMp3HalfSampleRate;
+      slot.skip = half ? entry.skip / 2 : entry.skip;
+      slot.samples = half ? entry.samples / 2 : entry.samples;
+      slot.gain = entry.gain;
+      return &slot.pack_src;
+    }
+  }
+  // With the boot-time index a missing clip costs no filesystem access, and the
+  // audio offset it recorded saves reading the ID3 header again.
+  AssetInfo info{};
+  const bool indexed = asset_index_ready();
+  if ((indexed && !asset_index_lookup(path, &info)) || !slot.file.open(path)) {
+    return nullptr;
+  }
+  const bool at_audio = indexed ? slot.file.seek(static_cast<int32_t>(info.audio_offset), SEEK_SET)
+                                : skip_id3(slot.file);
+  if (!at_audio) {
+    slot.file.close();
+    return nullptr;
+  }
+  slot.gen = &slot.mp3;
+  AudioFileSource* src = &slot.file;
+  if (is_m4a(path)) {
+    slot.gen = generator_for(slot, VoicePackCodec::kAacAdts);
+    if (!slot.gen || !slot.mp4.begin(&slot.file)) {
+      slot.file.close();
+      return nullptr;
+    }
+    src = &slot.mp4;
+  }
+  slot.skip = info.skip;
+  slot.samples = info.samples;
+  slot.gain = indexed ? info.gain : kVoicePackUnityGain;
+  slot.measure = indexed && info.samples == 0;
+  return src;
+}
+
+bool AnnouncementPlayer::has_clip(const char* path) {
+  if (!path) return false;
+  VoicePackEntry entry{};
+  for (VoicePack* pack : packs_) {
+    if (pack && pack->find(path, &entry)) return true;
+  }
+  return asset_index_ready() ? asset_index_lookup(path, nullptr) : fs_.exists(path);
+}
+
+uint16_t AnnouncementPlayer::clip_gain(const char* path) {
+  VoicePackEntry entry{};
+  for (VoicePack* pack : packs_) {
+    if (pack && pack->find(path, &entry)) return entry.gain;
+  }
+  AssetInfo info{};
+  return asset_index_lookup(path, &info) ? info.gain : kVoicePackUnityGain;
+}
+
+AudioGenerator* AnnouncementPlayer::generator_for(Slot& slot, VoicePackCodec codec) {
+  switch (codec) {
+    case VoicePackCodec::kMp3:
+      return &slot.mp3;
+    case VoicePackCodec::kImaAdpcm:
+      return &slot.adpcm;
+    case VoicePackCodec::kOpusSilk:
+      return &slot.silk;
+    case VoicePackCodec::kAacAdts:
+      break;
+  }
+  // ~85 KB of decoder state per slot (SBR included), too much to reserve for
+  // packs that never need it. Set up once and kept.
+  if (!slot.aac) {
+    constexpr int kBytes = AudioGeneratorAAC::preAllocSize();
+    void* space = heap_caps_malloc(kBytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!space) {
+      DBG_PRINTLN("AAC decoder: out of PSRAM");
+      return nullptr;
+    }
+    slot.aac = new AudioGeneratorAAC(space, kBytes);
+  }
+  return slot.aac;
+}
+
+bool AnnouncementPlayer::open_clip(Slot& slot, const char* path) {
+  slot.ready = false;
+  slot.cached = false;
+  slot.skip = 0;
+  slot.samples = 0;
+  slot.gain = kVoicePackUnityGain;
+  slot.measure = false;
+  AudioFileSource* src = open_source(slot, path);
+  if (!src) {
+    DBG_PRINT("Missing: ");
+    DBG_PRINTLN(path);
+    return false;
+  }
+  slot.out.reset();
+  if (!slot.gen->begin(src, &slot.out)) {
+    DBG_PRINT("Decoder begin failed: ");
+    DBG_PRINTLN(path);
+    src->close();
+    return false;
+  }
+  // A clip without a decodable frame still gets stopped by loop().
+  if (slot.gen == &slot.mp3) slot.mp3.prime();
+  slot.ready = true;
+  return true;
+}
+
+void AnnouncementPlayer::finish_clip(const Slot& slot, const char* path) {
+  uint32_t skip = 0;
+  uint32_t samples = 0;
+  const uint32_t pad = kTrimPadMs * static_cast<uint32_t>(tee_.GetRate()) / 1000;
+  if (slot.measure && tee_.measured(pad, &skip, &samples)) {
+    asset_index_set_trim(path, skip, samples, tee_.measured_gain());
+  }
+}
+
+void AnnouncementPlayer::release(Slot& slot) {
+  if (slot.gen && slot.gen->isRunning()) slot.gen->stop();
+  slot.ready = false;
+  slot.cached = false;
+}
+
+bool AnnouncementPlayer::play_cached(const char* path) {
+  PcmCache::Clip clip;
+  if (!cache_->find(path, &clip)) return false;
+  if (out_->GetRate() != clip.rate) out_->SetRate(clip.rate);
+  int16_t block[64][2];
+  uint32_t pos = 0;
+  while (pos < clip.count) {
+    const uint32_t left = clip.count - pos;
+    const uint16_t n = left > 64 ? 64 : static_cast<uint16_t>(left);
+    for (uint16_t k = 0; k < n; ++k) {
+      block[k][0] = block[k][1] = clip.samples[pos + k];
+    }
+    uint16_t sent = 0;
+    while (sent < n) {
+      sent += out_->ConsumeSamples(&block[sent][0], n - sent);
+      if (sent < n) wait_for_output();
+    }
+    pos += n;
+  }
+  return true;
+}
+
+void AnnouncementPlayer::write_silence(uint32_t ms) {
+  static int16_t zeros[64][2] = {};
+  uint32_t frames = ms * static_cast<uint32_t>(out_->GetRate()) / 1000;
+  while (frames > 0) {
+    const uint16_t n = frames > 64 ? 64 : static_cast<uint16_t>(frames);
+    const uint16_t sent = out_->ConsumeSamples(&zeros[0][0], n);
+    frames -= sent;
+    if (sent < n) wait_for_output();
+  }
+}
+
+bool AnnouncementPlayer::play(const char* const* paths, size_t count, const uint16_t* pauses_ms) {
+  if (!paths || count == 0 || !out_) return false;
+
+  bool ok = true;
+  Slot* cur = &slots_[0];
+  Slot* next = &slots_[1];
+  size_t next_index = 1;
+  bool join = false; // no pause since the previous clip
+
+  ok &= prime(*cur, paths[0]);
+  for (size_t i = 0; i < count; ++i) {
+    if (cur->ready) {
+      DBG_PRINT("Play: ");
+      DBG_PRINTLN(paths[i]);
+      xfade_.begin_clip(join);
+      out_->SetGain(static_cast<float>(cur->gain) / kVoicePackUnityGain);
+    }
+    if (cur->cached) {
+      cur->ready = false;
+      if (!play_cached(paths[i])) {
+        ok &= open_clip(*cur, paths[i]); // evicted since it was primed
+      }
+    }
+
+    if (cur->ready && !cur->out.go_live()) {
+      DBG_PRINT("Output rejected the format: ");
+      DBG_PRINTLN(paths[i]);
+      release(*cur);
+      ok = false;
+    }
+    if (cur->ready) {
+      tee_.begin_clip(cur->skip, cur->samples, cur->measure);
+      // An untrimmed first playback is not worth caching.
+      if (cache_ && !cur->measure) cache_->capture_begin(paths[i]);
+    }
+    while (cur->ready && cur->gen->isRunning()) {
+      // Stopping at the end of the speech skips decoding the trailing silence.
+      if (!cur->gen->loop() || tee_.clip_done()) {
+        cur->gen->stop();
+        break;
+      }
+      // Output is full: use the drain time to prepare the next clip.
+      if (next_index < count && next_index == i + 1 && !next->ready) {
+        ok &= prime(*next, paths[next_index]);
+        ++next_index;
+        continue;
+      }
+      wait_for_output();
+    }
+    if (cur->ready) {
+      finish_clip(*cur, paths[i]);
+      if (cache_ && !cur->measure) cache_->capture_commit(tee_.GetRate());
+    }
+    cur->ready = false;
+
+    // Written as samples so the pause stays exact however far decoding runs ahead.
+    const uint32_t pause = pauses_ms ? pauses_ms[i] : kClipPauseMs;
+    if (pause > 0 && i + 1 < count) {
+      xfade_.flush();
+      write_silence(pause);
+    }
+    join = (pause == 0);
+
+    if (i + 1 < count && next_index == i + 1) {
+      ok &= prime(*next, paths[next_index]);
+      ++next_index;
+    }
+    Slot* tmp = cur;
+    cur = next;
+    next = tmp;
+  }
+
+  xfade_.flush();
+  release(slots_[0]);
+  release(slots_[1]);
+  return ok;
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <AudioFileSourceFS.h>
+#include <AudioFileSourceMP4.h>
+#include <AudioGeneratorAAC.h>
+#include <AudioGeneratorADPCM.h>
+#include <AudioGeneratorMP3.h>
+#include <AudioGeneratorSILK.h>
+#include <AudioOutput.h>
+#include <FS.h>
+
+#include "asset_index.h"
+#include "crossfade_output.h"
+#include "pcm_cache.h"
+#include "voice_pack.h"
+
+// Plays a TimeSpeech/DateSpeech playlist into one output: each clip is cut
+// to its speech, scaled by its loudness gain, and followed by its pause or
+// crossfaded into the next. Clips come from a voice pack, the PCM cache or
+// LittleFS. Not thread-safe: play() runs on one task and returns once the
+// last clip is written; everything else is called between plays.
+class AnnouncementPlayer {
+ public:
+  explicit AnnouncementPlayer(fs::FS& fs);
+
+  void begin(AudioOutput* out) {
+    xfade_.set_target(out);
+    out_ = &xfade_;
+    tee_.set_target(&xfade_);
+  }
+  // Optional; may be set between plays.
+  void set_cache(PcmCache* cache) {
+    cache_ = cache;
+    tee_.set_cache(cache);
+  }
+  // Optional, up to two packs; must be added before the first play().
+  bool add_voice_pack(VoicePack* pack);
+  // pauses_ms (optional) holds the silence after each clip, default kClipPauseMs;
+  // 0 crossfades the clip into the next one.
+  // Returns false if any clip could not be played.
+  bool play(const char* const* paths, size_t count, const uint16_t* pauses_ms = nullptr);
+  // Whether play() finds the clip: in a voice pack, else among the files.
+  bool has_clip(const char* path);
+  // Writes the bounds and gains measured by play() to the asset index file.
+  // A flash write stalls the cache, so call it only while nothing is playing.
+  bool save_trims() { return asset_index_save_trims(fs_); }
+
+ private:
+  static constexpr int kArenaBytes = AudioGeneratorMP3::preAllocSize();
+  static constexpr size_t kMaxPacks = 2;
+
+  // What a slot's decoder is begun on. The next clip is primed while the
+  // current one still plays through the same chain, so until the clip
+  // starts the format its decoder asks for is only recorded; go_live()
+  // hands it on, and later changes and all samples then pass straight through.
+  class SlotOutput : public AudioOutput {
+   public:
+    void set_target(AudioOutput* out) { out_ = out; }
+    // Before begin()ing a decoder on it: detached, no format recorded.
+    void reset();
+    // Applies the recorded format to the target; false if it is rejected.
+    bool go_live();
+    bool SetRate(int hz) override;
+    bool SetBitsPerSample(int bits) override;
+    bool SetChannels(int chan) override;
+    bool begin() override { return live_ ? out_->begin() : true; }
+    bool ConsumeSample(int16_t sample[2]) override { return ConsumeSamples(sample, 1) == 1; }
+    uint16_t ConsumeSamples(int16_t* samples, uint16_t count) override { return out_->ConsumeSamples(samples, count); }
+    bool stop() override { return live_ ? out_->stop() : true; }
+
+   private:
+    AudioOutput* out_ = nullptr;
+    bool live_ = false;
+  };
+
+  struct Slot {
+    Slot(fs::FS& fs, uint8_t* arena) : file(fs), mp3(arena, kArenaBytes) {}
+    SlotOutput out; // in front of tee_
+    AudioFileSourceFS file;
+    AudioFileSourceMP4 mp4; // AAC track of a loose .m4a file
+    VoicePackSource pack_src;
+    AudioGeneratorMP3 mp3;
+    AudioGeneratorADPCM adpcm;
+    AudioGeneratorSILK silk;
+    AudioGeneratorAAC* aac = nullptr;
+    AudioGenerator* gen = nullptr; // whichever the clip needs
+    bool ready = false;
+    bool cached = false; // ready to replay from the cache, file not opened
+    uint32_t skip = 0;
+    uint32_t samples = 0; // 0 = play untrimmed
+    uint16_t gain = kVoicePackUnityGain; // Q15 loudness correction
+    bool measure = false; // find the speech bounds and loudness while playing
+  };
+
+  // Forwards the speech part of the decoder output and records it into the
+  // cache. Samples outside the clip's window are consumed and dropped.
+  class CaptureOutput : public AudioOutput {
+   public:
+    void set_target(AudioOutput* out) { out_ = out; }
+    void set_cache(PcmCache* cache) { cache_ = cache; }
+    void begin_clip(uint32_t skip, uint32_t samples, bool measure);
+    // The whole window has been forwarded; the rest of the clip is silence.
+    bool clip_done() const { return limit_ != 0 && pos_ >= skip_ + limit_; }
+    // Speech bounds seen since begin_clip(..., true); false if all silent.
+    bool measured(uint32_t pad, uint32_t* skip, uint32_t* samples) const;
+    // Q15 gain bringing the measured speech to kVoicePackLoudnessDb; attenuation only.
+    uint16_t measured_gain() const;
+    bool SetRate(int hz) override;
+    bool SetBitsPerSample(int bits) override;
+    bool SetChannels(int chan) override;
+    bool begin() override { return out_->begin(); }
+    bool ConsumeSample(int16_t sample[2]) override { return ConsumeSamples(sample, 1) == 1; }
+    uint16_t ConsumeSamples(int16_t* samples, uint16_t count) override;
+    bool stop() override { return out_->stop(); }
+
+   private:
+    AudioOutput* out_ = nullptr;
+    PcmCache* cache_ = nullptr;
+    uint32_t skip_ = 0;
+    uint32_t limit_ = 0;
+    uint32_t pos_ = 0; // decoded samples of the clip so far
+    bool measure_ = false;
+    uint32_t first_ = UINT32_MAX;
+    uint32_t last_ = 0;
+    // Gated loudness as tools/voice_pack measures it: the power of each
+    // 20 ms block, binned by level so the relative gate needs no second pass.
+    static constexpr int kLevelBins = 60; // 1 dB each, -60 .. 0 dBFS
+    void end_block();
+    float bin_power_[kLevelBins];
+    uint16_t bin_blocks_[kLevelBins];
+    uint64_t block_sum_ = 0;
+    uint32_t block_len_ = 0;
+  };
+
+  bool prime(Slot& slot, const char* path);
+  AudioGenerator* generator_for(Slot& slot, VoicePackCodec codec);
+  AudioFileSource* open_source(Slot& slot, const char* path);
+  bool open_clip(Slot& slot, const char* path);
+  uint16_t clip_gain(const char* path);
+  bool play_cached(const char* path);
+  void release(Slot& slot);
+  void finish_clip(const Slot& slot, const char* path);
+  void write_silence(uint32_t ms);
+
+  fs::FS& fs_;
+  AudioOutput* out_ = nullptr; // xfade_ once begun
+  PcmCache* cache_ = nullptr;
+  VoicePack* packs_[kMaxPacks] = {};
+  CaptureOutput tee_;
+  CrossfadeOutput xfade_;
+  // begin() re-inits the libmad state in place; stop() keeps the memory.
+  alignas(8) uint8_t arenas_[2][kArenaBytes];
+  Slot slots_[2];
+};
@@ -0,0 +1,212 @@
+#include "audio_task.h"
+
+#include <Arduino.h>
+#include <string.h>
+
+#include "boot_trace.h"
+#include "project_config.h"
+
+#if ENABLE_SERIAL_DEBUG
+#define DBG_PRINTF(...) Serial.printf(__VA_ARGS__)
+#else
+#define DBG_PRINTF(...)
+#endif
+
+namespace {
+constexpr uint32_t kDecodeStackBytes = 10240;
+constexpr uint32_t kFeedStackBytes = 3072;
+// The feeder must never starve behind the decoder.
+constexpr UBaseType_t kDecodePriority = 3;
+constexpr UBaseType_t kFeedPriority = 4;
+constexpr uint16_t kMonoChunk = 128;
+} // namespace
+
+bool AudioTask::RingOutput::SetChannels(int chan) {
+  // Decoders always hand over interleaved stereo; the ring's layout, mono or
+  // stereo, follows the I2S frames and is fixed in begin().
+  channels = chan;
+  return true;
+}
+
+bool AudioTask::RingOutput::SetGain(float f) {
+  if (f < 0.0f) f = 0.0f;
+  if (f > 1.0f) f = 1.0f;
+  const uint32_t head = owner_->marks_head_.load();
+  if (head - owner_->marks_tail_.load() == kMaxMarks) return false;
+  owner_->marks_[head % kMaxMarks] = {owner_->written_, static_cast<uint16_t>(f * GainStage::kUnity + 0.5f)};
+  owner_->marks_head_.store(head + 1);
+  return true;
+}
+
+uint16_t AudioTask::RingOutput::ConsumeSamples(int16_t* samples, uint16_t count) {
+  PcmRing& ring = owner_->ring_;
+  uint16_t done = 0;
+  if (ring.channels() == 1) {
+    // Fold to mono on the way in so the ring and the I2S path carry half the data.
+    while (done < count && ring.space() > 0) {
+      int16_t mono[kMonoChunk];
+      size_t n = count - done;
+      if (n > kMonoChunk) n = kMonoChunk;
+      if (n > ring.space()) n = ring.space();
+      const int16_t* s = samples + 2 * done;
+      for (size_t i = 0; i < n; ++i, s += 2) {
+        mono[i] = static_cast<int16_t>((s[0] + s[1]) >> 1);
+      }
+      done += ring.write(mono, n);
+    }
+  } else {
+    done = ring.write(samples, count);
+  }
+  if (done) {
+    boot_trace_mark(BootPhase::kFirstDecode);
+    owner_->written_ += done;
+  }
+  xTaskNotifyGive(owner_->feed_task_);
+  // A full ring returns short; the writer waits in wait_for_output() until
+  // the feeder has drained some of it.
+  return done;
+}
+
+bool AudioTask::begin(AnnouncementPlayer* player, AudioOutputI2S* out, int core) {
+  if (!player || !out || jobs_) return false;
+  player_ = player;
+  out_ = out;
+  // Match the ring to the I2S frame format so the feeder never converts.
+  if (!ring_.begin(kAudioRingFrames, out_->GetMonoFrames() ? 1 : 2)) return false;
+  jobs_ = xQueueCreate(1, sizeof(Job));
+  done_ = xSemaphoreCreateBinary();
+  if (!jobs_ || !done_) return false;
+  resample_.set_target(&ring_out_, kAudioOutputSampleRateHz);
+  resample_.set_taps(kResamplerTaps);
+  player_->begin(&resample_);
+  // Blocking writes: the feeder sleeps on the I2S event queue until a DMA
+  // buffer frees up, and flush() counts completions instead of sleeping.
+  out_->SetWriteTimeout(portMAX_DELAY);
+  out_->SetDmaEvents(true);
+  if (xTaskCreatePinnedToCore(feed_entry, "audio_feed", kFeedStackBytes, this,
+                              kFeedPriority, &feed_task_, core) != pdPASS) {
+    return false;
+  }
+  return xTaskCreatePinnedToCore(decode_entry, "audio_decode", kDecodeStackBytes, this,
+                                 kDecodePriority, &decode_task_, core) == pdPASS;
+}
+
+bool AudioTask::play(const char* const* paths, size_t count, const uint16_t* pauses_ms) {
+  if (!jobs_ || !paths || count == 0) return false;
+  bool expected = false;
+  if (!busy_.compare_exchange_strong(expected, true)) return false;
+  if (count > kMaxClips) count = kMaxClips;
+  Job job{};
+  for (size_t i = 0; i < count; ++i) {
+    strncpy(job.paths[i], paths[i] ? paths[i] : "", kMaxPathLen - 1);
+    job.pauses_ms[i] = pauses_ms ? pauses_ms[i] : kClipPauseMs;
+  }
+  job.count = count;
+  xSemaphoreTake(done_, 0);
+  if (xQueueSend(jobs_, &job, 0) != pdTRUE) {
+    busy_.store(false);
+    return false;
+  }
+  return true;
+}
+
+bool AudioTask::wait(uint32_t timeout_ms) {
+  if (busy_.load()) {
+    const TickType_t ticks = (timeout_ms == portMAX_DELAY) ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
+    if (xSemaphoreTake(done_, ticks) != pdTRUE) return false;
+  }
+  // The feeder has ended the I2S session, so the flash write cannot starve it.
+  if (player_) player_->save_trims();
+  return last_ok_;
+}
+
+void AudioTask::decode_entry(void* arg) {
+  static_cast<AudioTask*>(arg)->decode_loop();
+}
+
+void AudioTask::feed_entry(void* arg) {
+  static_cast<AudioTask*>(arg)->feed_loop();
+}
+
+void AudioTask::decode_loop() {
+  for (;;) {
+    if (xQueueReceive(jobs_, &job_, portMAX_DELAY) != pdTRUE) continue;
+    const char* paths[kMaxClips];
+    for (size_t i = 0; i < job_.count; ++i) paths[i] = job_.paths[i];
+    written_ = 0;
+    decoding_.store(true);
+    pending_.store(true);
+    xTaskNotifyGive(feed_task_);
+    last_ok_ = player_->play(paths, job_.count, job_.pauses_ms);
+    resample_.flush(); // the last frames are still in the filter
+    decoding_.store(false);
+    xTaskNotifyGive(feed_task_);
+  }
+}
+
+void AudioTask::feed_loop() {
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    if (!pending_.exchange(false)) continue; // stale wake-up from a ring write
+
+    const bool mono = (ring_.channels() == 1);
+    out_->SetRate(kAudioOutputSampleRateHz); // BENCH I2S may have left another rate
+    out_->beginSession();
+    out_->ResetDmaStats();
+    gain_.set_clip_gain(GainStage::kUnity);
+    gain_.settle(); // nothing is playing yet, so no ramp from the last session's level
+    uint32_t played = 0; // frames taken from the ring this session
+    size_t gained = 0;   // frames at the head of the ring already scaled
+    for (;;) {
+      if (service_cb_) service_cb_();
+      int16_t* frames = nullptr;
+      const size_t n = ring_.peek(&frames);
+      if (n > 0) {
+        const uint16_t chunk = n > 0xffff ? 0xffff : static_cast<uint16_t>(n);
+        // Scale in place, one pass split where a clip gain starts; frames
+        // I2S did not take stay scaled for the next write.
+        while (gained < chunk) {
+          size_t end = chunk;
+          const uint32_t tail = marks_tail_.load();
+          if (tail != marks_head_.load()) {
+            const GainMark& mark = marks_[tail % kMaxMarks];
+            if (mark.frame <= played + gained) {
+              gain_.set_clip_gain(mark.q15);
+              if (played + gained == 0) gain_.settle(); // the first clip starts at its level
+              marks_tail_.store(tail + 1);
+              continue;
+            }
+            if (mark.frame - played < end) end = mark.frame - played;
+          }
+          gain_.apply(frames + gained * ring_.channels(), end - gained, ring_.channels());
+          gained = end;
+        }
+        const size_t sent = mono ? out_->ConsumeMonoSamples(frames, chunk)
+                                 : out_->ConsumeSamples(frames, chunk);
+        if (sent) boot_trace_mark(BootPhase::kFirstDma);
+        ring_.consume(sent);
+        played += sent;
+        gained -= sent;
+        xTaskNotifyGive(decode_task_);
+        continue;
+      }
+      // Check the flag before the ring: the decoder's last write happens before it clears decoding_.
+      if (!decoding_.load()) {
+        if (ring_.available() == 0) break;
+        continue;
+      }
+      ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(20));
+    }
+    // Snapshot before endSession(): the drain tail always underflows.
+    const AudioOutputI2S::DmaStats stats = out_->GetDmaStats();
+    out_->endSession();
+    if (stats.underflows > 0) {
+      DBG_PRINTF("Audio: %u DMA underflows, %u buffers sent\n",
+                 static_cast<unsigned>(stats.underflows), static_cast<unsigned>(stats.txDone));
+    }
+    ring_.reset();
+    marks_tail_.store(marks_head_.load());
+    busy_.store(false);
+    xSemaphoreGive(done_);
+  }
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+#include <AudioOutput.h>
+#include <AudioOutputI2S.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#include "announcement_player.h"
+#include "gain_stage.h"
+#include "pcm_ring.h"
+#include "project_config.h"
+#include "resample_output.h"
+
+// Runs announcements off the Arduino loop task. A decoder task feeds
+// AnnouncementPlayer output, resampled to kAudioOutputSampleRateHz, into a
+// PcmRing; a feeder task drains the ring into I2S, sleeping on DMA
+// completion events, and owns the I2S session. I2S never changes rate.
+// The volume is applied by the feeder, one ramped pass per ring block,
+// together with the loudness gain of the clip the frames belong to.
+class AudioTask {
+ public:
+  using ServiceFn = void (*)();
+
+  static constexpr size_t kMaxClips = 10;
+  static constexpr size_t kMaxPathLen = 32;
+
+  // Starts both tasks pinned to `core`. Set the output frame format first.
+  bool begin(AnnouncementPlayer* player, AudioOutputI2S* out, int core);
+  // Called by the feeder task between writes, e.g. to refresh the volume.
+  void set_service_callback(ServiceFn fn) { service_cb_ = fn; }
+  // Q15 output gain (GainStage::kUnity = 1.0); any task. Reached within one block.
+  void set_gain(uint16_t q15) { gain_.set_target(q15); }
+
+  // Queues a playlist and returns immediately. Paths are copied.
+  // Returns false while a previous playlist is still playing.
+  bool play(const char* const* paths, size_t count, const uint16_t* pauses_ms = nullptr);
+  // Blocks until the current playlist has fully played out, then saves
+  // the clip bounds it measured. Returns false on timeout or if a clip failed.
+  bool wait(uint32_t timeout_ms = portMAX_DELAY);
+  bool busy() const { return busy_.load(); }
+
+ private:
+  struct Job {
+    char paths[kMaxClips][kMaxPathLen];
+    uint16_t pauses_ms[kMaxClips];
+    size_t count;
+  };
+
+  // A clip's loudness gain, from the ring frame its output starts at.
+  struct GainMark {
+    uint32_t frame;
+    uint16_t q15;
+  };
+  static constexpr uint32_t kMaxMarks = 16;
+
+  // Decoder-side sink: takes what fits in the ring. When it is full the count
+  // comes back short, the generator's loop() returns, and the player primes
+  // the next clip or sleeps until the feeder notifies it.
+  class RingOutput : public AudioOutput {
+   public:
+    explicit RingOutput(AudioTask* owner) : owner_(owner) {
+      hertz = kAudioOutputSampleRateHz;
+      bps = 16;
+      channels = 2;
+    }
+    bool SetChannels(int chan) override;
+    // Queues a clip gain mark at the next frame written; the feeder applies it.
+    bool SetGain(float f) override;
+    bool begin() override { return true; }
+    bool ConsumeSample(int16_t sample[2]) override { return ConsumeSamples(sample, 1) == 1; }
+    uint16_t ConsumeSamples(int16_t* samples, uint16_t count) override;
+    bool stop() override { return true; }
+
+   private:
+    AudioTask* owner_;
+  };
+
+  static void decode_entry(void* arg);
+  static void feed_entry(void* arg);
+  void decode_loop();
+  void feed_loop();
+
+  AnnouncementPlayer* player_ = nullptr;
+  AudioOutputI2S* out_ = nullptr;
+  ServiceFn service_cb_ = nullptr;
+  RingOutput ring_out_{this};
+  ResampleOutput resample_;
+  PcmRing ring_;
+  GainStage gain_;
+  // Single producer (decoder), single consumer (feeder), like the ring.
+  GainMark marks_[kMaxMarks] = {};
+  std::atomic<uint32_t> marks_head_{0};
+  std::atomic<uint32_t> marks_tail_{0};
+  uint32_t written_ = 0; // frames the decoder has put into the ring this playlist
+  Job job_{};
+  QueueHandle_t jobs_ = nullptr;
+  SemaphoreHandle_t done_ = nullptr;
+  TaskHandle_t decode_task_ = nullptr;
+  TaskHandle_t feed_task_ = nullptr;
+  std::atomic<bool> busy_{false};
+  std::atomic<bool> decoding_{false};
+  std::atomic<bool> pending_{false};
+  bool last_ok_ = true;
+};
@@ -0,0 +1,117 @@
+#include "crossfade_output.h"
+
+#include <Arduino.h>
+#include <math.h>
+#include <string.h>
+
+#include "output_wait.h"
+
+bool CrossfadeOutput::SetRate(int hz) {
+  if (hz != hertz) {
+    // The held frames belong to the old rate.
+    flush();
+    hertz = hz;
+    uint32_t window = static_cast<uint32_t>(window_ms_) * static_cast<uint32_t>(hz) / 1000;
+    if (window > kMaxFrames) window = kMaxFrames;
+    window_ = static_cast<uint16_t>(window);
+    for (uint16_t k = 0; k < window_; ++k) {
+      // 0.5 - 0.5 cos, sampled at the frame centres so neither end is exactly 0 or 1.
+      fade_in_[k] = static_cast<uint16_t>(lroundf(16384.0f * (1.0f - cosf(PI * (k + 0.5f) / window_))));
+    }
+  }
+  return out_->SetRate(hz);
+}
+
+bool CrossfadeOutput::SetBitsPerSample(int bits) {
+  bps = bits;
+  return out_->SetBitsPerSample(bits);
+}
+
+bool CrossfadeOutput::SetChannels(int chan) {
+  channels = chan;
+  return out_->SetChannels(chan);
+}
+
+bool CrossfadeOutput::SetGain(float f) {
+  if (f < 0.0f) f = 0.0f;
+  if (f > 1.0f) f = 1.0f;
+  // Held frames were written for gain_; the target will play them at f.
+  // Nothing can compensate a muted target, so the tail stays silent then.
+  if (held_ > 0 && f > 0.0f && f != gain_) {
+    const float scale = gain_ / f;
+    for (uint16_t k = 0; k < held_; ++k) {
+      for (int c = 0; c < 2; ++c) {
+        const int32_t v = lroundf(frames_[k][c] * scale);
+        frames_[k][c] = static_cast<int16_t>(v > 32767 ? 32767 : (v < -32768 ? -32768 : v));
+      }
+    }
+  }
+  gain_ = f;
+  return out_->SetGain(f);
+}
+
+void CrossfadeOutput::begin_clip(bool crossfade) {
+  if (mixing_) fade_out_rest();
+  if (crossfade && held_ > 0) {
+    mixing_ = true;
+    mix_pos_ = 0;
+  }
+}
+
+void CrossfadeOutput::fade_out_rest() {
+  // The new clip ended inside the window: the rest of the tail fades out alone.
+  for (uint16_t k = mix_pos_; k < held_; ++k) {
+    const int32_t out = 32768 - fade_in_[static_cast<uint32_t>(k) * window_ / held_];
+    frames_[k][0] = static_cast<int16_t>((frames_[k][0] * out + 16384) >> 15);
+    frames_[k][1] = static_cast<int16_t>((frames_[k][1] * out + 16384) >> 15);
+  }
+  mixing_ = false;
+}
+
+bool CrossfadeOutput::emit(uint16_t count) {
+  if (count == 0) return true;
+  const uint16_t sent = out_->ConsumeSamples(&frames_[0][0], count);
+  held_ -= sent;
+  memmove(frames_[0], frames_[sent], held_ * sizeof(frames_[0]));
+  return sent == count;
+}
+
+uint16_t CrossfadeOutput::ConsumeSamples(int16_t* samples, uint16_t count) {
+  if (window_ == 0 && held_ == 0) return out_->ConsumeSamples(samples, count);
+
+  uint16_t done = 0;
+  // The head of the new clip is mixed into the held tail in place. The tail
+  // is shorter than the window when the previous clip was.
+  while (mixing_ && done < count) {
+    const int32_t in = fade_in_[static_cast<uint32_t>(mix_pos_) * window_ / held_];
+    const int32_t out = 32768 - in;
+    const int16_t* s = samples + 2 * done;
+    frames_[mix_pos_][0] = static_cast<int16_t>((frames_[mix_pos_][0] * out + s[0] * in + 16384) >> 15);
+    frames_[mix_pos_][1] = static_cast<int16_t>((frames_[mix_pos_][1] * out + s[1] * in + 16384) >> 15);
+    ++done;
+    if (++mix_pos_ == held_) mixing_ = false;
+  }
+  if (done == count) return done;
+
+  // Keep the newest window_ frames; anything older goes out, held frames first.
+  const uint16_t rest = count - done;
+  if (held_ + rest > window_) {
+    const uint16_t from_held = (held_ + rest - window_ < held_) ? held_ + rest - window_ : held_;
+    if (!emit(from_held)) return done;
+    if (rest > window_) {
+      const uint16_t direct = rest - window_;
+      const uint16_t sent = out_->ConsumeSamples(samples + 2 * done, direct);
+      done += sent;
+      if (sent < direct) return done;
+    }
+  }
+  const uint16_t keep = count - done;
+  memcpy(frames_[held_], samples + 2 * done, keep * sizeof(frames_[0]));
+  held_ += keep;
+  return count;
+}
+
+void CrossfadeOutput::flush() {
+  if (mixing_) fade_out_rest();
+  while (!emit(held_)) wait_for_output();
+}
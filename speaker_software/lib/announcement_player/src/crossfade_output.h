@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <AudioOutput.h>
+
+// Overlaps the end of one clip with the start of the next. The last window
+// frames written are held back; when the next clip begins with a crossfade
+// they fade out under its first frames (raised cosine, Q15), so the pair
+// plays window frames shorter than back to back. Held frames are only
+// written on flush() or when newer frames push them out.
+class CrossfadeOutput : public AudioOutput {
+ public:
+  static constexpr uint16_t kMaxFrames = 512;
+
+  CrossfadeOutput() { hertz = 0; }
+  void set_target(AudioOutput* out) { out_ = out; }
+  // 0 disables the stage; takes effect at the next rate change.
+  void set_window_ms(uint16_t ms) { window_ms_ = ms; }
+  // Marks a clip boundary. With crossfade set, the held frames are mixed
+  // into the clip's first frames instead of being played before them.
+  void begin_clip(bool crossfade);
+
+  bool SetRate(int hz) override;
+  bool SetBitsPerSample(int bits) override;
+  bool SetChannels(int chan) override;
+  // Passed on at once. Call it after begin_clip() and before the clip's first
+  // frames: the held tail is rescaled so it still plays at its own clip's gain.
+  bool SetGain(float f) override;
+  bool begin() override { return out_->begin(); }
+  bool ConsumeSample(int16_t sample[2]) override { return ConsumeSamples(sample, 1) == 1; }
+  uint16_t ConsumeSamples(int16_t* samples, uint16_t count) override;
+  // Generators stop after every clip, so this keeps the held frames.
+  bool stop() override { return out_->stop(); }
+  // Writes the held frames; blocks until the target has taken them.
+  void flush() override;
+
+ private:
+  void fade_out_rest();
+  bool emit(uint16_t count);
+
+  AudioOutput* out_ = nullptr;
+  uint16_t window_ms_ = 0;
+  uint16_t window_ = 0;  // frames held back at the current rate
+  uint16_t held_ = 0;
+  uint16_t mix_pos_ = 0; // held frames already mixed with the new clip
+  bool mixing_ = false;
+  float gain_ = 1.0f;    // gain the target currently applies
+  int16_t frames_[kMaxFrames][2];
+  uint16_t fade_in_[kMaxFrames]; // Q15 gain of the new clip over the window
+};
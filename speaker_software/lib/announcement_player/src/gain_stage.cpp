@@ -0,0 +1,31 @@
+#include "gain_stage.h"
+
+namespace {
+// Extra fraction bits carried by the ramp, so short blocks still end on target.
+constexpr int kRampShift = 12;
+constexpr int32_t kRampOne = 1 << kRampShift;
+
+inline int16_t scale(int16_t s, int32_t q15) {
+  return static_cast<int16_t>((s * q15 + (1 << 14)) >> 15);
+}
+} // namespace
+
+void GainStage::apply(int16_t* samples, size_t frames, uint8_t channels) {
+  if (frames == 0) return;
+  const uint16_t target = effective();
+  if (current_ == target) {
+    if (target == kUnity) return;
+    const size_t count = frames * channels;
+    for (size_t i = 0; i < count; ++i) samples[i] = scale(samples[i], target);
+    return;
+  }
+  // Multiply rather than shift: the difference is negative on a ramp down.
+  int32_t g = static_cast<int32_t>(current_) * kRampOne;
+  const int32_t step = (static_cast<int32_t>(target) - current_) * kRampOne / static_cast<int32_t>(frames);
+  for (size_t i = 0; i < frames; ++i) {
+    g += step;
+    const int32_t q15 = g >> kRampShift;
+    for (uint8_t ch = 0; ch < channels; ++ch, ++samples) *samples = scale(*samples, q15);
+  }
+  current_ = target;
+}
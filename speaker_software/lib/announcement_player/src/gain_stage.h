@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+// Q15 output gain, applied to a block of PCM in one pass. The gain moves
+// linearly from where the last block ended to the target across each block,
+// so a volume change never steps within the signal. The target is the
+// volume times the current clip's loudness gain. The volume may be set
+// from any task; the clip gain and apply() belong to one.
+class GainStage {
+ public:
+  static constexpr uint16_t kUnity = 32768;
+
+  // 0 .. kUnity; larger values are clamped.
+  void set_target(uint16_t q15) { target_.store(q15 > kUnity ? kUnity : q15); }
+  uint16_t target() const { return target_.load(); }
+  void set_clip_gain(uint16_t q15) { clip_ = q15 > kUnity ? kUnity : q15; }
+  // Jumps to the target without a ramp; for the start of a stream.
+  void settle() { current_ = effective(); }
+  // Scales `frames` frames of `channels` interleaved samples in place.
+  void apply(int16_t* samples, size_t frames, uint8_t channels);
+
+ private:
+  uint16_t effective() const {
+    return static_cast<uint16_t>((static_cast<uint32_t>(target_.load()) * clip_ + (1 << 14)) >> 15);
+  }
+
+  std::atomic<uint16_t> target_{kUnity};
+  uint16_t clip_ = kUnity;
+  uint16_t current_ = kUnity;
+};
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+// How long a writer sleeps on a full output before it retries anyway.
+constexpr uint32_t kOutputWaitMs = 20;
+
+// Blocks the writing task until the consumer behind a full output has made
+// room: AudioTask's feeder notifies the decoder task after every I2S write.
+inline void wait_for_output() {
+  ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(kOutputWaitMs));
+}
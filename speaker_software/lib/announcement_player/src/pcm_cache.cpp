@@ -0,0 +1,119 @@
+#include "pcm_cache.h"
+
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+#include <string.h>
+
+namespace {
+void* psram_alloc(size_t bytes) {
+  return heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+}
+} // namespace
+
+PcmCache::~PcmCache() {
+  for (size_t i = 0; i < count_; ++i) heap_caps_free(entries_[i].samples);
+  heap_caps_free(stage_);
+}
+
+bool PcmCache::begin(size_t budget_bytes) {
+  budget_ = 0;
+  if (!psramFound() || budget_bytes == 0) return false;
+  budget_ = budget_bytes;
+  return true;
+}
+
+int PcmCache::index_of(const char* path) const {
+  for (size_t i = 0; i < count_; ++i) {
+    if (strncmp(entries_[i].path, path, kMaxPathLen) == 0) return static_cast<int>(i);
+  }
+  return -1;
+}
+
+bool PcmCache::contains(const char* path) const {
+  return enabled() && path && index_of(path) >= 0;
+}
+
+bool PcmCache::find(const char* path, Clip* clip) {
+  if (!enabled() || !path || !clip) return false;
+  const int i = index_of(path);
+  if (i < 0) return false;
+  ++stats_.hits;
+  Entry& e = entries_[i];
+  e.last_used = ++clock_;
+  clip->samples = e.samples;
+  clip->count = e.count;
+  clip->rate = e.rate;
+  return true;
+}
+
+void PcmCache::evict(size_t index) {
+  stats_.bytes -= entries_[index].count * sizeof(int16_t);
+  heap_caps_free(entries_[index].samples);
+  entries_[index] = entries_[--count_];
+  ++stats_.evictions;
+  stats_.clips = static_cast<uint32_t>(count_);
+}
+
+bool PcmCache::make_room(size_t bytes) {
+  if (bytes > budget_) return false;
+  while (count_ > 0 && (count_ == kMaxClips || stats_.bytes + bytes > budget_)) {
+    size_t oldest = 0;
+    for (size_t i = 1; i < count_; ++i) {
+      if (entries_[i].last_used < entries_[oldest].last_used) oldest = i;
+    }
+    evict(oldest);
+  }
+  return true;
+}
+
+void PcmCache::capture_begin(const char* path) {
+  if (enabled()) ++stats_.misses;
+  capturing_ = enabled() && path && strlen(path) < kMaxPathLen && index_of(path) < 0;
+  if (!capturing_) return;
+  strncpy(stage_path_, path, kMaxPathLen);
+  stage_len_ = 0;
+}
+
+void PcmCache::capture(const int16_t* frames, size_t count) {
+  if (!capturing_) return;
+  if ((stage_len_ + count) * sizeof(int16_t) > budget_) {
+    capturing_ = false; // could never be stored
+    return;
+  }
+  if (stage_len_ + count > stage_cap_) {
+    // The staging buffer only grows, so after the longest clip it never moves again.
+    size_t cap = stage_cap_ + kStageGrowSamples;
+    while (cap < stage_len_ + count) cap += kStageGrowSamples;
+    int16_t* grown = static_cast<int16_t*>(
+        heap_caps_realloc(stage_, cap * sizeof(int16_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT));
+    if (!grown) {
+      capturing_ = false;
+      return;
+    }
+    stage_ = grown;
+    stage_cap_ = cap;
+  }
+  int16_t* d = stage_ + stage_len_;
+  for (size_t i = 0; i < count; ++i, frames += 2) {
+    *d++ = static_cast<int16_t>((frames[0] + frames[1]) >> 1);
+  }
+  stage_len_ += count;
+}
+
+void PcmCache::capture_commit(int rate) {
+  if (!capturing_) return;
+  capturing_ = false;
+  const size_t bytes = stage_len_ * sizeof(int16_t);
+  if (stage_len_ == 0 || !make_room(bytes)) return;
+  int16_t* samples = static_cast<int16_t*>(psram_alloc(bytes));
+  if (!samples) return;
+  memcpy(samples, stage_, bytes);
+  Entry& e = entries_[count_++];
+  strncpy(e.path, stage_path_, kMaxPathLen);
+  e.samples = samples;
+  e.count = static_cast<uint32_t>(stage_len_);
+  e.rate = rate;
+  e.last_used = ++clock_;
+  stats_.bytes += bytes;
+  stats_.clips = static_cast<uint32_t>(count_);
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Decoded clips kept in PSRAM, keyed by path, as mono 16-bit samples at the
+// clip's own rate. The least recently played clips are evicted to stay
+// within the byte budget. Used from the decoder task only.
+class PcmCache {
+ public:
+  struct Clip {
+    const int16_t* samples;
+    uint32_t count;
+    int rate;
+  };
+
+  struct Stats {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t evictions;
+    uint32_t clips;
+    size_t bytes;
+  };
+
+  ~PcmCache();
+
+  // Returns false without PSRAM; the cache then stays disabled.
+  bool begin(size_t budget_bytes);
+  bool enabled() const { return budget_ > 0; }
+
+  // A hit marks the clip as most recently used. The samples stay valid
+  // until the next capture_commit().
+  bool find(const char* path, Clip* clip);
+  bool contains(const char* path) const;
+
+  // Records the decoded output of one clip; commit() makes it visible.
+  // Every capture_begin() counts as a miss.
+  void capture_begin(const char* path);
+  void capture(const int16_t* frames, size_t count); // interleaved stereo
+  void capture_commit(int rate);
+
+  Stats stats() const { return stats_; }
+
+ private:
+  static constexpr size_t kMaxClips = 96;
+  static constexpr size_t kMaxPathLen = 32;
+  static constexpr size_t kStageGrowSamples = 16384;
+
+  struct Entry {
+    char path[kMaxPathLen];
+    int16_t* samples;
+    uint32_t count;
+    int rate;
+    uint32_t last_used;
+  };
+
+  int index_of(const char* path) const;
+  bool make_room(size_t bytes);
+  void evict(size_t index);
+
+  size_t budget_ = 0;
+  Entry entries_[kMaxClips] = {};
+  size_t count_ = 0;
+  uint32_t clock_ = 0;
+  Stats stats_ = {};
+
+  char stage_path_[kMaxPathLen] = {};
+  int16_t* stage_ = nullptr;
+  size_t stage_len_ = 0;
+  size_t stage_cap_ = 0;
+  bool capturing_ = false;
+};
@@ -0,0 +1,64 @@
+#include "pcm_ring.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+PcmRing::~PcmRing() {
+  free(buf_);
+}
+
+bool PcmRing::begin(size_t frames, uint8_t channels) {
+  if (channels != 1 && channels != 2) return false;
+  uint32_t size = 1;
+  while (size < frames) size <<= 1;
+  int16_t* buf = static_cast<int16_t*>(malloc(size * channels * sizeof(int16_t)));
+  if (!buf) return false;
+  free(buf_);
+  buf_ = buf;
+  channels_ = channels;
+  size_ = size;
+  mask_ = size - 1;
+  reset();
+  return true;
+}
+
+void PcmRing::reset() {
+  head_.store(0, std::memory_order_relaxed);
+  tail_.store(0, std::memory_order_relaxed);
+}
+
+size_t PcmRing::space() const {
+  return size_ - (head_.load(std::memory_order_relaxed) - tail_.load(std::memory_order_acquire));
+}
+
+size_t PcmRing::available() const {
+  return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_relaxed);
+}
+
+size_t PcmRing::write(const int16_t* frames, size_t count) {
+  const uint32_t head = head_.load(std::memory_order_relaxed);
+  const size_t free_frames = space();
+  if (count > free_frames) count = free_frames;
+  if (count == 0) return 0;
+  const uint32_t start = head & mask_;
+  const size_t first = (count < size_ - start) ? count : size_ - start;
+  memcpy(buf_ + channels_ * start, frames, first * channels_ * sizeof(int16_t));
+  if (count > first) {
+    memcpy(buf_, frames + channels_ * first, (count - first) * channels_ * sizeof(int16_t));
+  }
+  head_.store(head + static_cast<uint32_t>(count), std::memory_order_release);
+  return count;
+}
+
+size_t PcmRing::peek(int16_t** frames) const {
+  const size_t avail = available();
+  if (avail == 0) return 0;
+  const uint32_t start = tail_.load(std::memory_order_relaxed) & mask_;
+  *frames = buf_ + channels_ * start;
+  return (avail < size_ - start) ? avail : size_ - start;
+}
+
+void PcmRing::consume(size_t count) {
+  tail_.store(tail_.load(std::memory_order_relaxed) + static_cast<uint32_t>(count),
+              std::memory_order_release);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+// Lock-free single-producer/single-consumer ring of 16-bit frames, mono or
+// interleaved stereo. One task writes, one task reads; no locks are taken.
+class PcmRing {
+ public:
+  ~PcmRing();
+
+  // Capacity is rounded up to a power of two.
+  bool begin(size_t frames, uint8_t channels = 2);
+  uint8_t channels() const { return channels_; }
+  // Only while neither side is active.
+  void reset();
+
+  // Producer side. Returns the number of frames stored.
+  size_t write(const int16_t* frames, size_t count);
+  size_t space() const;
+
+  // Consumer side. peek() returns the contiguous readable run without
+  // copying; consume() releases it once the frames have been used.
+  size_t peek(int16_t** frames) const;
+  void consume(size_t count);
+  size_t available() const;
+
+ private:
+  int16_t* buf_ = nullptr;
+  uint32_t size_ = 0;
+  uint32_t mask_ = 0;
+  uint8_t channels_ = 2;
+  std::atomic<uint32_t> head_{0}; // written by the producer only
+  std::atomic<uint32_t> tail_{0}; // written by the consumer only
+};
@@ -0,0 +1,183 @@
+#include "resample_output.h"
+
+#include <Arduino.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "output_wait.h"
+
+namespace {
+// Passband edge relative to the lower Nyquist frequency, and Kaiser beta (~80 dB stopband).
+constexpr float kCutoff = 0.9f;
+constexpr float kKaiserBeta = 8.0f;
+
+uint32_t gcd(uint32_t a, uint32_t b) {
+  while (b) {
+    const uint32_t t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+float bessel_i0(float x) {
+  float sum = 1.0f;
+  float term = 1.0f;
+  for (int k = 1; k < 32 && term > 1e-9f * sum; ++k) {
+    term *= (x / (2.0f * k)) * (x / (2.0f * k));
+    sum += term;
+  }
+  return sum;
+}
+} // namespace
+
+ResampleOutput::~ResampleOutput() {
+  free(coefs_);
+}
+
+void ResampleOutput::set_target(AudioOutput* out, int out_hz) {
+  out_ = out;
+  out_hz_ = out_hz;
+  out_->SetRate(out_hz);
+}
+
+bool ResampleOutput::SetRate(int hz) {
+  if (hz == hertz) return true;
+  // The buffered frames belong to the old rate.
+  flush();
+  if (!configure(hz)) return false;
+  hertz = hz;
+  return true;
+}
+
+bool ResampleOutput::SetBitsPerSample(int bits) {
+  bps = bits;
+  return out_->SetBitsPerSample(bits);
+}
+
+bool ResampleOutput::SetChannels(int chan) {
+  channels = chan;
+  mono_ = (chan == 1);
+  return out_->SetChannels(chan);
+}
+
+bool ResampleOutput::configure(int in_hz) {
+  if (in_hz <= 0 || out_hz_ <= 0) return false;
+  const uint32_t g = gcd(static_cast<uint32_t>(in_hz), static_cast<uint32_t>(out_hz_));
+  const uint32_t up = static_cast<uint32_t>(out_hz_) / g;
+  const uint32_t down = static_cast<uint32_t>(in_hz) / g;
+  if (up > kMaxPhases) return false;
+  const uint8_t len = taps_ < 2 ? 2 : (taps_ > kMaxTaps ? kMaxTaps : taps_);
+  if (up != down) {
+    const size_t need = static_cast<size_t>(up) * len;
+    if (need > coef_capacity_) {
+      int16_t* p = static_cast<int16_t*>(realloc(coefs_, need * sizeof(int16_t)));
+      if (!p) return false;
+      coefs_ = p;
+      coef_capacity_ = need;
+    }
+    // Prototype of up * len taps at up times the input rate, cut off below
+    // the lower of the two Nyquist frequencies; tap k of phase p is
+    // prototype tap p + (len - 1 - k) * up.
+    const float fc = 0.5f * kCutoff / static_cast<float>(up > down ? up : down);
+    const float centre = 0.5f * static_cast<float>(up * len - 1);
+    const float i0_beta = bessel_i0(kKaiserBeta);
+    float taps[kMaxTaps];
+    for (uint32_t p = 0; p < up; ++p) {
+      float sum = 0.0f;
+      for (uint8_t k = 0; k < len; ++k) {
+        const float t = static_cast<float>(p + (len - 1 - k) * up) - centre;
+        const float x = 2.0f * fc * t;
+        const float sinc = (t == 0.0f) ? 1.0f : sinf(PI * x) / (PI * x);
+        const float r = t / (centre + 0.5f);
+        const float w = bessel_i0(kKaiserBeta * sqrtf(fmaxf(0.0f, 1.0f - r * r))) / i0_beta;
+        taps[k] = sinc * w;
+        sum += taps[k];
+      }
+      // Unity gain at DC for every phase; the rounding error goes to the largest tap.
+      int16_t* c = coefs_ + p * len;
+      int32_t total = 0;
+      uint8_t largest = 0;
+      for (uint8_t k = 0; k < len; ++k) {
+        c[k] = static_cast<int16_t>(lroundf(16384.0f * taps[k] / sum));
+        total += c[k];
+        if (abs(c[k]) > abs(c[largest])) largest = k;
+      }
+      c[largest] = static_cast<int16_t>(c[largest] + 16384 - total);
+    }
+  }
+  up_ = up;
+  down_ = down;
+  per_input_ = static_cast<uint8_t>((up + down - 1) / down);
+  len_ = len;
+  phase_ = 0;
+  pos_ = 0;
+  memset(hist_, 0, sizeof(hist_));
+  pending_ = false;
+  return true;
+}
+
+bool ResampleOutput::emit() {
+  if (block_len_ == 0) return true;
+  const uint16_t sent = out_->ConsumeSamples(&block_[0][0], block_len_);
+  block_len_ -= sent;
+  if (block_len_) memmove(block_[0], block_[sent], block_len_ * sizeof(block_[0]));
+  return block_len_ == 0;
+}
+
+void ResampleOutput::drain() {
+  while (!emit()) wait_for_output();
+}
+
+bool ResampleOutput::SetGain(float f) {
+  // The block still held belongs to the clip before the gain change.
+  drain();
+  return out_->SetGain(f);
+}
+
+void ResampleOutput::push(const int16_t* frame) {
+  const uint8_t chans = mono_ ? 1 : 2;
+  for (uint8_t ch = 0; ch < chans; ++ch) {
+    hist_[ch][pos_] = hist_[ch][pos_ + len_] = frame[ch];
+  }
+  if (++pos_ == len_) pos_ = 0;
+  // Every output frame between this input frame and the next.
+  for (; phase_ < up_; phase_ += down_) {
+    const int16_t* c = coefs_ + phase_ * len_;
+    for (uint8_t ch = 0; ch < chans; ++ch) {
+      const int16_t* x = &hist_[ch][pos_];
+      int32_t acc = 1 << 13;
+      for (uint8_t k = 0; k < len_; ++k) acc += static_cast<int32_t>(c[k]) * x[k];
+      acc >>= 14;
+      block_[block_len_][ch] = static_cast<int16_t>(acc > 32767 ? 32767 : (acc < -32768 ? -32768 : acc));
+    }
+    if (mono_) block_[block_len_][1] = block_[block_len_][0];
+    ++block_len_;
+  }
+  phase_ -= up_;
+}
+
+uint16_t ResampleOutput::ConsumeSamples(int16_t* samples, uint16_t count) {
+  if (up_ == down_) return out_->ConsumeSamples(samples, count);
+  // Input is taken only while the block has room for all it produces.
+  uint16_t i = 0;
+  for (; i < count; ++i) {
+    if (kBlockFrames - block_len_ < per_input_ && !emit()) break;
+    push(samples + 2 * i);
+  }
+  emit();
+  if (i) pending_ = true;
+  return i;
+}
+
+void ResampleOutput::flush() {
+  if (up_ == down_ || !pending_) return;
+  static const int16_t kSilence[2] = {0, 0};
+  for (uint8_t i = 0; i < len_ / 2; ++i) {
+    while (kBlockFrames - block_len_ < per_input_ && !emit()) wait_for_output();
+    push(kSilence);
+  }
+  drain();
+  pending_ = false;
+}
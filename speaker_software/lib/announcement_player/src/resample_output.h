@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <AudioOutput.h>
+
+// Converts every clip to one fixed rate, so the target (and the I2S clock
+// behind it) never changes rate. Rational polyphase resampler: the ratio is
+// reduced to up/down, and each output frame is one dot product of the last
+// taps input frames with one of `up` Q14 phase filters cut from a
+// Kaiser-windowed sinc. More taps buy a steeper anti-imaging/anti-aliasing
+// filter for proportionally more cycles. Equal rates pass straight through;
+// mono clips are filtered once and duplicated.
+class ResampleOutput : public AudioOutput {
+ public:
+  static constexpr uint8_t kMaxTaps = 32;
+  static constexpr uint32_t kMaxPhases = 640; // 11025 -> 48000 Hz
+
+  ResampleOutput() { hertz = 0; }
+  ~ResampleOutput() override;
+  // out_hz is the only rate the target is ever given.
+  void set_target(AudioOutput* out, int out_hz);
+  // 2 .. kMaxTaps; takes effect at the next rate change.
+  void set_taps(uint8_t taps) { taps_ = taps; }
+
+  // Fails for rate pairs needing more than kMaxPhases phases, or without memory.
+  bool SetRate(int hz) override;
+  bool SetBitsPerSample(int bits) override;
+  bool SetChannels(int chan) override;
+  // Passed on once the frames produced so far have gone out.
+  bool SetGain(float f) override;
+  bool begin() override { return out_->begin(); }
+  bool ConsumeSample(int16_t sample[2]) override { return ConsumeSamples(sample, 1) == 1; }
+  // Takes frames while the target takes the output; a short count means
+  // the target is full and the rest should be offered again later.
+  uint16_t ConsumeSamples(int16_t* samples, uint16_t count) override;
+  bool stop() override { return out_->stop(); }
+  // Pushes the filter delay (taps / 2 frames of silence) through, so the
+  // last frames written reach the target; blocks until they have.
+  void flush() override;
+
+ private:
+  static constexpr uint16_t kBlockFrames = 128;
+
+  bool configure(int in_hz);
+  void push(const int16_t* frame);
+  bool emit(); // false while part of the block is still held
+  void drain();
+
+  AudioOutput* out_ = nullptr;
+  int out_hz_ = 0;
+  uint8_t taps_ = 16;
+  uint8_t len_ = 0;           // taps of the current filter
+  uint32_t up_ = 1;
+  uint32_t down_ = 1;
+  uint8_t per_input_ = 1;     // most output frames one input frame yields
+  uint32_t phase_ = 0;        // next output, in 1/up_ after the newest input frame
+  int16_t* coefs_ = nullptr;  // up_ phases of len_ Q14 taps, oldest frame first
+  size_t coef_capacity_ = 0;
+  // Each frame is stored twice, len_ apart, so every window is contiguous.
+  int16_t hist_[2][2 * kMaxTaps] = {};
+  uint8_t pos_ = 0;           // oldest frame of the window
+  bool mono_ = false;
+  bool pending_ = false;      // frames written since the last flush()
+  int16_t block_[kBlockFrames][2];
+  uint16_t block_len_ = 0;
+};
@@ -0,0 +1,233 @@
+#include "asset_index.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "project_config.h"
+
+namespace {
+struct Entry {
+  uint32_t hash;
+  uint32_t name; // offset into g_names
+  uint32_t size;
+  uint32_t audio_offset;
+  uint32_t skip;
+  uint32_t samples;
+  uint16_t gain;
+};
+
+// kTrimIndexPath: TrimFileHeader, then TrimRecord[count]. Trims count
+// samples at the synthesis rate, so a change of kMp3HalfSampleRate
+// discards them.
+struct TrimFileHeader {
+  char magic[4];
+  uint16_t version;
+  uint16_t half_rate;
+  uint32_t count;
+};
+
+struct TrimRecord {
+  uint32_t hash;
+  uint32_t size; // file size when measured; a replaced clip is measured again
+  uint32_t skip;
+  uint32_t samples;
+  uint16_t gain;
+  uint16_t reserved;
+};
+
+constexpr char kTrimMagic[4] = {'T', 'R', 'I', 'M'};
+// 2: measured on the gapless decoder output (encoder delay and padding dropped)
+// 3: loudness gain per clip
+constexpr uint16_t kTrimVersion = 3;
+constexpr uint16_t kUnityGain = 32768;
+
+Entry* g_entries = nullptr;
+size_t g_count = 0;
+size_t g_capacity = 0;
+char* g_names = nullptr;
+size_t g_names_len = 0;
+size_t g_names_cap = 0;
+uint16_t* g_table = nullptr; // entry index + 1, 0 = empty
+uint32_t g_mask = 0;
+bool g_trims_dirty = false;
+
+uint32_t fnv1a(const char* s) {
+  uint32_t h = 2166136261u;
+  while (*s) {
+    h ^= static_cast<uint8_t>(*s++);
+    h *= 16777619u;
+  }
+  return h;
+}
+
+bool add_entry(const char* path, uint32_t size, uint32_t audio_offset) {
+  if (g_count == 0xffff) return false; // table stores 16-bit indices
+  if (g_count == g_capacity) {
+    const size_t cap = g_capacity ? g_capacity * 2 : 256;
+    Entry* e = static_cast<Entry*>(realloc(g_entries, cap * sizeof(Entry)));
+    if (!e) return false;
+    g_entries = e;
+    g_capacity = cap;
+  }
+  const size_t len = strlen(path) + 1;
+  if (g_names_len + len > g_names_cap) {
+    size_t cap = g_names_cap ? g_names_cap * 2 : 4096;
+    while (cap < g_names_len + len) cap *= 2;
+    char* n = static_cast<char*>(realloc(g_names, cap));
+    if (!n) return false;
+    g_names = n;
+    g_names_cap = cap;
+  }
+  memcpy(g_names + g_names_len, path, len);
+  g_entries[g_count++] = {fnv1a(path), static_cast<uint32_t>(g_names_len), size, audio_offset, 0, 0, kUnityGain};
+  g_names_len += len;
+  return true;
+}
+
+void scan_dir(fs::FS& fs, const char* dir) {
+  File root = fs.open(dir, "r");
+  if (!root || !root.isDirectory()) return;
+  File f = root.openNextFile();
+  while (f) {
+    if (!f.isDirectory()) {
+      char path[64];
+      snprintf(path, sizeof(path), "%s/%s", dir, f.name());
+      // openNextFile() already opened the file, so reading the tag header is cheap here.
+      uint8_t hdr[10];
+      const uint32_t offset = (f.read(hdr, sizeof(hdr)) == sizeof(hdr)) ? id3_tag_size(hdr) : 0;
+      add_entry(path, static_cast<uint32_t>(f.size()), offset);
+    }
+    f.close();
+    f = root.openNextFile();
+  }
+  root.close();
+}
+
+bool build_table() {
+  uint32_t size = 1;
+  while (size < g_count * 2) size <<= 1;
+  g_table = static_cast<uint16_t*>(calloc(size, sizeof(uint16_t)));
+  if (!g_table) return false;
+  g_mask = size - 1;
+  for (size_t i = 0; i < g_count; ++i) {
+    uint32_t slot = g_entries[i].hash & g_mask;
+    while (g_table[slot] != 0) slot = (slot + 1) & g_mask;
+    g_table[slot] = static_cast<uint16_t>(i + 1);
+  }
+  return true;
+}
+
+Entry* find_entry(const char* path) {
+  if (!g_table || !path) return nullptr;
+  const uint32_t hash = fnv1a(path);
+  for (uint32_t slot = hash & g_mask; g_table[slot] != 0; slot = (slot + 1) & g_mask) {
+    Entry& e = g_entries[g_table[slot] - 1];
+    if (e.hash == hash && strcmp(g_names + e.name, path) == 0) return &e;
+  }
+  return nullptr;
+}
+
+void load_trims(fs::FS& fs) {
+  File f = fs.open(kTrimIndexPath, "r");
+  if (!f) return;
+  TrimFileHeader hdr{};
+  const bool valid = f.read(reinterpret_cast<uint8_t*>(&hdr), sizeof(hdr)) == sizeof(hdr) &&
+                     memcmp(hdr.magic, kTrimMagic, sizeof(hdr.magic)) == 0 && hdr.version == kTrimVersion &&
+                     hdr.half_rate == (kMp3HalfSampleRate ? 1 : 0);
+  TrimRecord r;
+  for (uint32_t i = 0; valid && i < hdr.count; ++i) {
+    if (f.read(reinterpret_cast<uint8_t*>(&r), sizeof(r)) != sizeof(r)) break;
+    for (uint32_t slot = r.hash & g_mask; g_table[slot] != 0; slot = (slot + 1) & g_mask) {
+      Entry& e = g_entries[g_table[slot] - 1];
+      if (e.hash == r.hash && e.size == r.size) {
+        e.skip = r.skip;
+        e.samples = r.samples;
+        e.gain = r.gain;
+      }
+    }
+  }
+  f.close();
+}
+} // namespace
+
+uint32_t id3_tag_size(const uint8_t hdr[10]) {
+  if (hdr[0] != 'I' || hdr[1] != 'D' || hdr[2] != '3') return 0;
+  uint32_t size = (static_cast<uint32_t>(hdr[6] & 0x7f) << 21) |
+                  (static_cast<uint32_t>(hdr[7] & 0x7f) << 14) |
+                  (static_cast<uint32_t>(hdr[8] & 0x7f) << 7) |
+                  static_cast<uint32_t>(hdr[9] & 0x7f);
+  size += 10;
+  if (hdr[5] & 0x10) size += 10; // footer present
+  return size;
+}
+
+bool asset_index_begin(fs::FS& fs) {
+  free(g_table);
+  g_table = nullptr;
+  g_count = 0;
+  g_names_len = 0;
+  scan_dir(fs, kAudioBasePathDe);
+  scan_dir(fs, kAudioBasePathEn);
+  // No clips (both directories empty or missing) is a valid, empty index.
+  if (!build_table()) return false;
+  load_trims(fs);
+  g_trims_dirty = false;
+  return true;
+}
+
+bool asset_index_ready() {
+  return g_table != nullptr;
+}
+
+size_t asset_index_count() {
+  return g_count;
+}
+
+bool asset_index_lookup(const char* path, AssetInfo* info) {
+  const Entry* e = find_entry(path);
+  if (!e) return false;
+  if (info) {
+    info->size = e->size;
+    info->audio_offset = e->audio_offset;
+    info->skip = e->skip;
+    info->samples = e->samples;
+    info->gain = e->gain;
+  }
+  return true;
+}
+
+bool asset_index_set_trim(const char* path, uint32_t skip, uint32_t samples, uint16_t gain) {
+  Entry* e = find_entry(path);
+  if (!e || samples == 0) return false;
+  if (e->skip != skip || e->samples != samples || e->gain != gain) {
+    e->skip = skip;
+    e->samples = samples;
+    e->gain = gain;
+    g_trims_dirty = true;
+  }
+  return true;
+}
+
+bool asset_index_save_trims(fs::FS& fs) {
+  if (!g_trims_dirty) return true;
+  File f = fs.open(kTrimIndexPath, "w");
+  if (!f) return false;
+  TrimFileHeader hdr{};
+  memcpy(hdr.magic, kTrimMagic, sizeof(hdr.magic));
+  hdr.version = kTrimVersion;
+  hdr.half_rate = kMp3HalfSampleRate ? 1 : 0;
+  for (size_t i = 0; i < g_count; ++i) {
+    if (g_entries[i].samples != 0) ++hdr.count;
+  }
+  bool ok = f.write(reinterpret_cast<const uint8_t*>(&hdr), sizeof(hdr)) == sizeof(hdr);
+  for (size_t i = 0; ok && i < g_count; ++i) {
+    const Entry& e = g_entries[i];
+    if (e.samples == 0) continue;
+    const TrimRecord r{e.hash, e.size, e.skip, e.samples, e.gain, 0};
+    ok = f.write(reinterpret_cast<const uint8_t*>(&r), sizeof(r)) == sizeof(r);
+  }
+  f.close();
+  g_trims_dirty = !ok;
+  return ok;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <FS.h>
+
+struct AssetInfo {
+  uint32_t size;         // file size in bytes
+  uint32_t audio_offset; // first byte after the ID3v2 tag
+  uint32_t skip;         // decoded samples before the speech starts
+  uint32_t samples;      // speech samples after skip, 0 until measured
+  uint16_t gain;         // Q15 loudness correction, 32768 (unity) until measured
+};
+
+// One-time scan of the clip directories (/mp3, /mp3_en) into an in-RAM
+// hash index, so playback never asks LittleFS whether a clip exists.
+// Silence trims measured on earlier boots are loaded from kTrimIndexPath.
+// Fails only when the index cannot be allocated; no clips is a ready index.
+bool asset_index_begin(fs::FS& fs);
+bool asset_index_ready();
+size_t asset_index_count();
+
+// info may be null to only test for presence.
+bool asset_index_lookup(const char* path, AssetInfo* info);
+
+// Records the speech bounds and loudness gain measured while a clip played untrimmed.
+bool asset_index_set_trim(const char* path, uint32_t skip, uint32_t samples, uint16_t gain);
+// Writes the trims to kTrimIndexPath if any were added since the last save.
+bool asset_index_save_trims(fs::FS& fs);
+
+// Size of a leading ID3v2 tag (header and footer included), 0 if none.
+// `hdr` holds the first 10 bytes of the file.
+uint32_t id3_tag_size(const uint8_t hdr[10]);
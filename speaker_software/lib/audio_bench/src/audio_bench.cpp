@@ -0,0 +1,550 @@
+#include "audio_bench.h"
+
+#include <Arduino.h>
+#include <AudioFileSourceLittleFS.h>
+#include <AudioFileSourceMP4.h>
+#include <AudioFileSourcePROGMEM.h>
+#include <AudioGeneratorAAC.h>
+#include <AudioGeneratorADPCM.h>
+#include <AudioGeneratorMP3.h>
+#include <AudioGeneratorSILK.h>
+#include <LittleFS.h>
+#include <esp_heap_caps.h>
+#include <math.h>
+#include <string.h>
+
+#include "project_config.h"
+#include "resample_output.h"
+#include "voice_pack.h"
+
+#if ENABLE_SERIAL_DEBUG
+#define DBG_PRINTLN(...) Serial.println(__VA_ARGS__)
+#define DBG_PRINTF(...) Serial.printf(__VA_ARGS__)
+#else
+#define DBG_PRINTLN(...)
+#define DBG_PRINTF(...)
+#endif
+
+namespace {
+constexpr int kBenchRateHz = 24000; // rate of the shipped speech clips
+constexpr size_t kToneLen = 256;
+constexpr uint16_t kBlockFrames = 128;
+// The repository's m4a/ clips, uploaded next to the MP3 set for BENCH AAC
+constexpr const char* kBenchM4aDir = "/m4a";
+// tools/voice_pack --opus build of the German clips, uploaded for BENCH OPUS
+constexpr const char* kBenchOpusPack = "/voice_de_opus.vpk";
+
+int16_t g_tone[kToneLen][2];
+
+void fill_tone() {
+  for (size_t i = 0; i < kToneLen; ++i) {
+    const float v = sinf(2.0f * static_cast<float>(M_PI) * static_cast<float>(i) / kToneLen);
+    g_tone[i][0] = g_tone[i][1] = static_cast<int16_t>(v * 8000.0f);
+  }
+}
+
+// Cycles spent inside ConsumeSample() for one second of audio.
+uint32_t bench_per_sample(AudioOutputI2S* out) {
+  uint32_t cycles = 0;
+  for (int i = 0; i < kBenchRateHz; ) {
+    int16_t s[2] = {g_tone[i % kToneLen][0], g_tone[i % kToneLen][1]};
+    const uint32_t t0 = ESP.getCycleCount();
+    const bool ok = out->ConsumeSample(s);
+    cycles += ESP.getCycleCount() - t0;
+    if (ok) {
+      ++i;
+    } else {
+      delay(1);
+    }
+  }
+  return cycles;
+}
+
+// Cycles spent inside ConsumeSamples() for one second of audio.
+uint32_t bench_block(AudioOutputI2S* out) {
+  int16_t block[kBlockFrames][2];
+  uint32_t cycles = 0;
+  for (int i = 0; i < kBenchRateHz; ) {
+    uint16_t n = kBlockFrames;
+    if (kBenchRateHz - i < n) n = static_cast<uint16_t>(kBenchRateHz - i);
+    for (uint16_t k = 0; k < n; ++k) {
+      block[k][0] = g_tone[(i + k) % kToneLen][0];
+      block[k][1] = g_tone[(i + k) % kToneLen][1];
+    }
+    uint16_t sent = 0;
+    while (sent < n) {
+      const uint32_t t0 = ESP.getCycleCount();
+      sent += out->ConsumeSamples(&block[sent][0], n - sent);
+      cycles += ESP.getCycleCount() - t0;
+      if (sent < n) delay(1);
+    }
+    i += n;
+  }
+  return cycles;
+}
+
+void bench_i2s(AudioOutputI2S* out) {
+  fill_tone();
+  out->SetBitsPerSample(16);
+  out->SetChannels(1);
+  out->SetRate(kBenchRateHz);
+  out->SetGain(0.0f); // silent, the write path still runs
+  // Non-blocking writes, so the counts exclude time spent waiting for DMA space.
+  out->SetWriteTimeout(0);
+  if (!out->beginSession()) {
+    DBG_PRINTLN("BENCH I2S: output begin failed");
+    out->SetWriteTimeout(portMAX_DELAY);
+    return;
+  }
+  const uint32_t per_sample = bench_per_sample(out);
+  const uint32_t block = bench_block(out);
+  out->endSession();
+  out->SetGain(1.0f); // the audio task applies the volume itself
+  out->SetWriteTimeout(portMAX_DELAY); // the audio task's feeder writes blocking
+  DBG_PRINTF("BENCH I2S: %d Hz mono, cycles per output second\n", kBenchRateHz);
+  DBG_PRINTF("  ConsumeSample  : %u (%.2f%% CPU)\n", per_sample,
+             per_sample * 100.0f / (ESP.getCpuFreqMHz() * 1000000.0f));
+  DBG_PRINTF("  ConsumeSamples : %u (%.2f%% CPU)\n", block,
+             block * 100.0f / (ESP.getCpuFreqMHz() * 1000000.0f));
+}
+
+// Swallows decoded PCM so only the decoder is measured.
+class NullOutput : public AudioOutput {
+ public:
+  NullOutput() {
+    hertz = 0;
+    bps = 16;
+    channels = 2;
+  }
+  bool begin() override { return true; }
+  bool ConsumeSample(int16_t sample[2]) override {
+    (void)sample;
+    ++frames;
+    return true;
+  }
+  uint16_t ConsumeSamples(int16_t* samples, uint16_t count) override {
+    (void)samples;
+    frames += count;
+    return count;
+  }
+  bool stop() override { return true; }
+  uint32_t frames = 0;
+};
+
+struct DecodeResult {
+  uint64_t cycles = 0;
+  uint32_t mp3_frames = 0;
+  int rate = 0;
+};
+
+// Decodes every clip in `dir` with the given libmad options.
+DecodeResult bench_decode_dir(const char* dir, int options) {
+  DecodeResult res;
+  File root = LittleFS.open(dir, "r");
+  if (!root) return res;
+  File f = root.openNextFile();
+  while (f) {
+    char path[64];
+    snprintf(path, sizeof(path), "%s/%s", dir, f.name());
+    const bool is_file = !f.isDirectory();
+    f.close();
+    if (is_file) {
+      AudioFileSourceLittleFS src(path);
+      NullOutput out;
+      AudioGeneratorMP3 mp3;
+      mp3.SetDecodeOptions(options);
+      if (mp3.begin(&src, &out)) {
+        while (mp3.isRunning()) {
+          const uint32_t t0 = ESP.getCycleCount();
+          const bool more = mp3.loop();
+          res.cycles += ESP.getCycleCount() - t0;
+          if (!more) mp3.stop();
+        }
+        // MPEG-1 frames carry 1152 samples, MPEG-2/2.5 frames 576.
+        const int src_rate = (options & MAD_OPTION_HALFSAMPLERATE) ? 2 * out.GetRate() : out.GetRate();
+        int per_frame = (src_rate >= 32000) ? 1152 : 576;
+        if (options & MAD_OPTION_HALFSAMPLERATE) per_frame /= 2;
+        res.mp3_frames += out.frames / per_frame;
+        res.rate = out.GetRate();
+      }
+    }
+    f = root.openNextFile();
+  }
+  root.close();
+  return res;
+}
+
+// Keeps the decoded mono PCM of one clip.
+class PcmCapture : public NullOutput {
+ public:
+  PcmCapture(int16_t* buf, uint32_t capacity) : buf_(buf), capacity_(capacity) {}
+  uint16_t ConsumeSamples(int16_t* samples, uint16_t count) override {
+    for (uint16_t i = 0; i < count && frames < capacity_; ++i) buf_[frames++] = samples[2 * i];
+    return count;
+  }
+
+ private:
+  int16_t* buf_;
+  uint32_t capacity_;
+};
+
+constexpr uint32_t kAdpcmMaxSamples = 10 * kBenchRateHz; // longest clip, PCM and ADPCM in PSRAM
+constexpr int kAdpcmBlockBytes = 256;
+
+void put_u16(uint8_t*& p, uint16_t v) {
+  *p++ = static_cast<uint8_t>(v);
+  *p++ = static_cast<uint8_t>(v >> 8);
+}
+
+void put_u32(uint8_t*& p, uint32_t v) {
+  put_u16(p, static_cast<uint16_t>(v));
+  put_u16(p, static_cast<uint16_t>(v >> 16));
+}
+
+// Same layout as tools/voice_pack writes: RIFF, fmt (0x0011), fact, data.
+size_t make_adpcm_wav(const int16_t* pcm, uint32_t count, int rate, uint8_t* out) {
+  const int per_block = ima_adpcm_block_samples(kAdpcmBlockBytes);
+  uint8_t* data = out + 60;
+  uint32_t bytes = 0;
+  ima_adpcm_state state{0, 0};
+  for (uint32_t i = 0; i < count; i += per_block) {
+    const int n = (count - i < static_cast<uint32_t>(per_block)) ? static_cast<int>(count - i) : per_block;
+    bytes += ima_adpcm_encode_block(pcm + i, n, data + bytes, &state);
+  }
+  uint8_t* p = out;
+  memcpy(p, "RIFF", 4);
+  p += 4;
+  put_u32(p, 52 + bytes);
+  memcpy(p, "WAVEfmt ", 8);
+  p += 8;
+  put_u32(p, 20);
+  put_u16(p, 0x0011);
+  put_u16(p, 1);
+  put_u32(p, rate);
+  put_u32(p, static_cast<uint32_t>(rate) * kAdpcmBlockBytes / per_block);
+  put_u16(p, kAdpcmBlockBytes);
+  put_u16(p, 4);
+  put_u16(p, 2);
+  put_u16(p, per_block);
+  memcpy(p, "fact", 4);
+  p += 4;
+  put_u32(p, 4);
+  put_u32(p, count);
+  memcpy(p, "data", 4);
+  p += 4;
+  put_u32(p, bytes);
+  return 60 + bytes;
+}
+
+struct CodecResult {
+  uint64_t cycles = 0;
+  uint64_t bytes = 0;
+};
+
+struct CodecRow {
+  const char* name;
+  const CodecResult& res;
+};
+
+void print_codec_rows(const CodecRow* rows, size_t count, float seconds, uint32_t clips) {
+  const float hz = ESP.getCpuFreqMHz() * 1000000.0f;
+  for (size_t i = 0; i < count; ++i) {
+    const float per_second = static_cast<float>(rows[i].res.cycles) / seconds;
+    DBG_PRINTF("  %-6s: %.0f (%.2f%% CPU, %.1f MHz), %.2f Mcycles/clip, %u bytes/clip\n", rows[i].name, per_second,
+               per_second * 100.0f / hz, per_second / 1000000.0f, rows[i].res.cycles / 1e6f / clips,
+               static_cast<unsigned>(rows[i].res.bytes / clips));
+  }
+}
+
+// Runs a generator to the end; returns the cycles spent in loop().
+uint64_t time_decode(AudioGenerator& gen, AudioFileSource* src, AudioOutput* out) {
+  uint64_t cycles = 0;
+  if (!gen.begin(src, out)) return 0;
+  while (gen.isRunning()) {
+    const uint32_t t0 = ESP.getCycleCount();
+    const bool more = gen.loop();
+    cycles += ESP.getCycleCount() - t0;
+    if (!more) gen.stop();
+  }
+  return cycles;
+}
+
+// Decodes every German clip as MP3 (single channel, as played), re-encodes
+// the output as IMA ADPCM in RAM and decodes that again.
+void bench_adpcm() {
+  int16_t* pcm = static_cast<int16_t*>(heap_caps_malloc(kAdpcmMaxSamples * 2, MALLOC_CAP_SPIRAM));
+  uint8_t* wav = static_cast<uint8_t*>(heap_caps_malloc(64 + kAdpcmMaxSamples / 2, MALLOC_CAP_SPIRAM));
+  static AudioGeneratorADPCM adpcm; // block buffers, too large for the CLI stack
+  CodecResult mp3_res;
+  CodecResult adpcm_res;
+  uint64_t samples = 0;
+  uint32_t clips = 0;
+  int rate = 0;
+  File root = pcm && wav ? LittleFS.open(kAudioBasePathDe, "r") : File();
+  File f = root ? root.openNextFile() : File();
+  while (f) {
+    char path[64];
+    snprintf(path, sizeof(path), "%s/%s", kAudioBasePathDe, f.name());
+    const bool is_file = !f.isDirectory();
+    const size_t size = f.size();
+    f.close();
+    if (is_file) {
+      AudioFileSourceLittleFS src(path);
+      PcmCapture out(pcm, kAdpcmMaxSamples);
+      AudioGeneratorMP3 mp3;
+      mp3.SetDecodeOptions(MAD_OPTION_SINGLECHANNEL);
+      uint64_t cycles = 0;
+      if (mp3.begin(&src, &out)) {
+        while (mp3.isRunning()) {
+          const uint32_t t0 = ESP.getCycleCount();
+          const bool more = mp3.loop();
+          cycles += ESP.getCycleCount() - t0;
+          if (!more) mp3.stop();
+        }
+      }
+      if (out.frames > 0 && out.frames <= kAdpcmMaxSamples) {
+        mp3_res.cycles += cycles;
+        mp3_res.bytes += size;
+        rate = out.GetRate();
+        const size_t len = make_adpcm_wav(pcm, out.frames, rate, wav);
+        AudioFileSourcePROGMEM mem(wav, len);
+        NullOutput sink;
+        if (adpcm.begin(&mem, &sink)) {
+          while (adpcm.isRunning()) {
+            const uint32_t t0 = ESP.getCycleCount();
+            const bool more = adpcm.loop();
+            adpcm_res.cycles += ESP.getCycleCount() - t0;
+            if (!more) adpcm.stop();
+          }
+        }
+        adpcm_res.bytes += len;
+        samples += out.frames;
+        ++clips;
+      }
+    }
+    f = root.openNextFile();
+  }
+  if (root) root.close();
+  heap_caps_free(pcm);
+  heap_caps_free(wav);
+  if (clips == 0) {
+    DBG_PRINTLN("BENCH ADPCM: no clips decoded");
+    return;
+  }
+  const float seconds = static_cast<float>(samples) / rate;
+  DBG_PRINTF("BENCH ADPCM: %s, %u clips, %.1f s at %d Hz; decode cycles per audio second\n", kAudioBasePathDe,
+             static_cast<unsigned>(clips), seconds, rate);
+  const CodecRow rows[] = {{"MP3", mp3_res}, {"ADPCM", adpcm_res}};
+  print_codec_rows(rows, 2, seconds, clips);
+}
+
+// Decodes every clip of kBenchM4aDir through AudioFileSourceMP4 and the MP3
+// clip of the same name, both as played (mono), and compares file sizes and
+// decode time per second of the MP3 clip.
+void bench_aac() {
+  constexpr int kAacBytes = AudioGeneratorAAC::preAllocSize();
+  void* space = heap_caps_malloc(kAacBytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  static AudioFileSourceMP4 mp4; // sample tables, too large for the CLI stack
+  CodecResult mp3_res;
+  CodecResult aac_res;
+  uint64_t samples = 0;
+  uint32_t clips = 0;
+  int rate = 0;
+  File root = space ? LittleFS.open(kBenchM4aDir, "r") : File();
+  File f = root ? root.openNextFile() : File();
+  while (f) {
+    char m4a_path[64];
+    char mp3_path[64];
+    snprintf(m4a_path, sizeof(m4a_path), "%s/%s", kBenchM4aDir, f.name());
+    const char* dot = strrchr(f.name(), '.');
+    const int stem = dot ? static_cast<int>(dot - f.name()) : static_cast<int>(strlen(f.name()));
+    snprintf(mp3_path, sizeof(mp3_path), "%s/%.*s.mp3", kAudioBasePathDe, stem, f.name());
+    const bool is_file = !f.isDirectory();
+    const size_t m4a_size = f.size();
+    f.close();
+    File mp3_file = is_file ? LittleFS.open(mp3_path, "r") : File();
+    if (mp3_file) {
+      const size_t mp3_size = mp3_file.size();
+      mp3_file.close();
+      AudioFileSourceLittleFS mp3_src(mp3_path);
+      NullOutput mp3_out;
+      AudioGeneratorMP3 mp3;
+      mp3.SetDecodeOptions(MAD_OPTION_SINGLECHANNEL);
+      const uint64_t mp3_cycles = time_decode(mp3, &mp3_src, &mp3_out);
+
+      AudioFileSourceLittleFS m4a_src(m4a_path);
+      NullOutput aac_out;
+      AudioGeneratorAAC aac(space, kAacBytes);
+      const uint64_t aac_cycles = mp4.begin(&m4a_src) ? time_decode(aac, &mp4, &aac_out) : 0;
+      if (mp3_out.frames > 0 && aac_out.frames > 0) {
+        mp3_res.cycles += mp3_cycles;
+        mp3_res.bytes += mp3_size;
+        aac_res.cycles += aac_cycles;
+        aac_res.bytes += m4a_size;
+        samples += mp3_out.frames;
+        rate = mp3_out.GetRate();
+        ++clips;
+      }
+    }
+    f = root.openNextFile();
+  }
+  if (root) root.close();
+  heap_caps_free(space);
+  if (clips == 0) {
+    DBG_PRINTF("BENCH AAC: no clip pairs in %s and %s\n", kBenchM4aDir, kAudioBasePathDe);
+    return;
+  }
+  const float seconds = static_cast<float>(samples) / rate;
+  DBG_PRINTF("BENCH AAC: %s vs. %s, %u clips, %.1f s at %d Hz; decode cycles per audio second\n", kBenchM4aDir,
+             kAudioBasePathDe, static_cast<unsigned>(clips), seconds, rate);
+  const CodecRow rows[] = {{"MP3", mp3_res}, {"AAC", aac_res}};
+  print_codec_rows(rows, 2, seconds, clips);
+}
+
+// Decodes every German MP3 clip as played (mono) and its SILK-only Opus
+// counterpart from kBenchOpusPack, and compares sizes, decode time per
+// second of the MP3 clip and the decoder memory.
+void bench_opus() {
+  static VoicePack pack;
+  static AudioGeneratorSILK silk; // kept: its state is allocated by the first begin()
+  CodecResult mp3_res;
+  CodecResult opus_res;
+  uint64_t samples = 0;
+  uint32_t clips = 0;
+  int rate = 0;
+  File root = pack.open(LittleFS, kBenchOpusPack, kAudioBasePathDe) ? LittleFS.open(kAudioBasePathDe, "r") : File();
+  File f = root ? root.openNextFile() : File();
+  while (f) {
+    char path[64];
+    snprintf(path, sizeof(path), "%s/%s", kAudioBasePathDe, f.name());
+    const bool is_file = !f.isDirectory();
+    const size_t size = f.size();
+    f.close();
+    VoicePackEntry entry{};
+    VoicePackSource opus_src;
+    if (is_file && pack.find(path, &entry) && opus_src.begin(&pack, entry)) {
+      AudioFileSourceLittleFS mp3_src(path);
+      NullOutput mp3_out;
+      AudioGeneratorMP3 mp3;
+      mp3.SetDecodeOptions(MAD_OPTION_SINGLECHANNEL);
+      const uint64_t mp3_cycles = time_decode(mp3, &mp3_src, &mp3_out);
+
+      NullOutput opus_out;
+      const uint64_t opus_cycles = time_decode(silk, &opus_src, &opus_out);
+      if (mp3_out.frames > 0 && opus_out.frames > 0) {
+        mp3_res.cycles += mp3_cycles;
+        mp3_res.bytes += size;
+        opus_res.cycles += opus_cycles;
+        opus_res.bytes += entry.length;
+        samples += mp3_out.frames;
+        rate = mp3_out.GetRate();
+        ++clips;
+      }
+    }
+    f = root.openNextFile();
+  }
+  if (root) root.close();
+  pack.close();
+  if (clips == 0) {
+    DBG_PRINTF("BENCH OPUS: no clips of %s found in %s\n", kAudioBasePathDe, kBenchOpusPack);
+    return;
+  }
+  const float seconds = static_cast<float>(samples) / rate;
+  DBG_PRINTF("BENCH OPUS: %s vs. %s, %u clips, %.1f s at %d Hz; decode cycles per audio second\n", kBenchOpusPack,
+             kAudioBasePathDe, static_cast<unsigned>(clips), seconds, rate);
+  const CodecRow rows[] = {{"MP3", mp3_res}, {"SILK", opus_res}};
+  print_codec_rows(rows, 2, seconds, clips);
+  DBG_PRINTF("  decoder RAM: MP3 %d bytes, SILK %d bytes (an opus_decode() state alone: %d bytes)\n",
+             AudioGeneratorMP3::preAllocSize(), silk.getStateBytes(), opus_decoder_get_size(1));
+}
+
+// Feeds one second of a mono tone at each clip rate through ResampleOutput
+// for each filter length; cycles per output frame at kAudioOutputSampleRateHz.
+void bench_resample() {
+  static const uint8_t kTaps[] = {8, 16, 32};
+  static const int kRates[] = {16000, kBenchRateHz, 22050};
+  fill_tone();
+  DBG_PRINTF("BENCH RESAMPLE: mono to %d Hz, cycles per output frame (default %u taps)\n",
+             kAudioOutputSampleRateHz, static_cast<unsigned>(kResamplerTaps));
+  for (uint8_t taps : kTaps) {
+    DBG_PRINTF("  %2u taps:", static_cast<unsigned>(taps));
+    for (int rate : kRates) {
+      NullOutput sink;
+      ResampleOutput rs;
+      rs.set_target(&sink, kAudioOutputSampleRateHz);
+      rs.set_taps(taps);
+      rs.SetChannels(1);
+      if (!rs.SetRate(rate)) {
+        DBG_PRINTF(" %5d Hz: no memory", rate);
+        continue;
+      }
+      uint64_t cycles = 0;
+      int16_t block[kBlockFrames][2];
+      for (int i = 0; i < rate; i += kBlockFrames) {
+        const uint16_t n = static_cast<uint16_t>(rate - i < kBlockFrames ? rate - i : kBlockFrames);
+        for (uint16_t k = 0; k < n; ++k) {
+          block[k][0] = block[k][1] = g_tone[(i + k) % kToneLen][0];
+        }
+        const uint32_t t0 = ESP.getCycleCount();
+        rs.ConsumeSamples(&block[0][0], n);
+        cycles += ESP.getCycleCount() - t0;
+      }
+      DBG_PRINTF(" %5d Hz: %5.1f", rate, sink.frames ? static_cast<float>(cycles) / sink.frames : 0.0f);
+    }
+    DBG_PRINTLN();
+  }
+}
+
+void bench_mp3() {
+  struct Mode {
+    const char* name;
+    int options;
+  };
+  static const Mode kModes[] = {
+      {"full", 0},
+      {"single", MAD_OPTION_SINGLECHANNEL},
+      {"half", MAD_OPTION_HALFSAMPLERATE},
+      {"single+half", MAD_OPTION_SINGLECHANNEL | MAD_OPTION_HALFSAMPLERATE},
+  };
+  DBG_PRINTF("BENCH MP3: %s, decode cycles per MP3 frame\n", kAudioBasePathDe);
+  for (const Mode& mode : kModes) {
+    const DecodeResult res = bench_decode_dir(kAudioBasePathDe, mode.options);
+    if (res.mp3_frames == 0) {
+      DBG_PRINTLN("BENCH MP3: no clips decoded");
+      return;
+    }
+    DBG_PRINTF("  %-12s: %u frames, %u Hz out, %u cycles/frame\n", mode.name,
+               static_cast<unsigned>(res.mp3_frames), static_cast<unsigned>(res.rate),
+               static_cast<unsigned>(res.cycles / res.mp3_frames));
+  }
+}
+} // namespace
+
+bool audio_bench_run(const char* name, AudioOutputI2S* out) {
+  if (!name || !out) return false;
+  if (strcasecmp(name, "I2S") == 0) {
+    bench_i2s(out);
+    return true;
+  }
+  if (strcasecmp(name, "MP3") == 0) {
+    bench_mp3();
+    return true;
+  }
+  if (strcasecmp(name, "ADPCM") == 0) {
+    bench_adpcm();
+    return true;
+  }
+  if (strcasecmp(name, "AAC") == 0) {
+    bench_aac();
+    return true;
+  }
+  if (strcasecmp(name, "OPUS") == 0) {
+    bench_opus();
+    return true;
+  }
+  if (strcasecmp(name, "RESAMPLE") == 0) {
+    bench_resample();
+    return true;
+  }
+  return false;
+}
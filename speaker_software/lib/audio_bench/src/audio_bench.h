@@ -0,0 +1,7 @@
+#pragma once
+
+#include <AudioOutputI2S.h>
+
+// On-device audio benchmarks, started from the serial CLI ("BENCH <name>").
+// Results are printed over serial. Returns false for an unknown name.
+bool audio_bench_run(const char* name, AudioOutputI2S* out);
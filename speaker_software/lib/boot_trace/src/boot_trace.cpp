@@ -0,0 +1,139 @@
+#include "boot_trace.h"
+
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <string.h>
+
+#include <atomic>
+
+#include "project_config.h"
+
+#if ENABLE_SERIAL_DEBUG
+#define DBG_PRINTF(...) Serial.printf(__VA_ARGS__)
+#else
+#define DBG_PRINTF(...)
+#endif
+
+namespace {
+constexpr size_t kPhases = static_cast<size_t>(BootPhase::kCount);
+constexpr uint32_t kNotReached = UINT32_MAX;
+
+// kBootTracePath: TraceFileHeader, then TraceRecord[count], oldest first.
+struct TraceFileHeader {
+  char magic[4];
+  uint16_t version;
+  uint16_t count;
+};
+
+struct TraceRecord {
+  uint32_t seq;      // traces recorded so far, this one included
+  uint8_t power_up;
+  uint8_t reserved[3];
+  uint32_t end_us[kPhases]; // kNotReached if the phase did not run
+};
+
+constexpr char kTraceMagic[4] = {'B', 'T', 'R', 'C'};
+constexpr uint16_t kTraceVersion = 1;
+
+const char* const kPhaseNames[kPhases] = {
+    "rtc begin", "fs begin", "fs list", "app state", "assets",
+    "wifi portal", "i2s setup", "first decode", "first dma", "power off",
+};
+
+std::atomic<bool> g_active{false};
+bool g_power_up = false;
+int64_t g_start_us = 0;
+std::atomic<uint32_t> g_end_us[kPhases];
+
+void print_record(const TraceRecord& r) {
+  DBG_PRINTF("Trace #%u (%s):\n", static_cast<unsigned>(r.seq), r.power_up ? "power-up" : "button");
+  // In the order the phases ended, which depends on the boot path.
+  bool shown[kPhases] = {};
+  uint32_t prev = 0;
+  for (;;) {
+    size_t next = kPhases;
+    for (size_t i = 0; i < kPhases; ++i) {
+      if (shown[i] || r.end_us[i] == kNotReached) continue;
+      if (next == kPhases || r.end_us[i] < r.end_us[next]) next = i;
+    }
+    if (next == kPhases) break;
+    shown[next] = true;
+    DBG_PRINTF("  %-12s %9.3f ms  (+%.3f)\n", kPhaseNames[next], r.end_us[next] / 1000.0f,
+               (r.end_us[next] - prev) / 1000.0f);
+    prev = r.end_us[next];
+  }
+}
+
+// Reads up to kBootTraceKeep records; none if the file is missing or stale.
+size_t load_records(fs::FS& fs, TraceRecord* records) {
+  File f = fs.open(kBootTracePath, "r");
+  if (!f) return 0;
+  TraceFileHeader hdr{};
+  size_t count = 0;
+  if (f.read(reinterpret_cast<uint8_t*>(&hdr), sizeof(hdr)) == sizeof(hdr) &&
+      memcmp(hdr.magic, kTraceMagic, sizeof(hdr.magic)) == 0 && hdr.version == kTraceVersion) {
+    while (count < hdr.count && count < kBootTraceKeep &&
+           f.read(reinterpret_cast<uint8_t*>(&records[count]), sizeof(TraceRecord)) == sizeof(TraceRecord)) {
+      ++count;
+    }
+  }
+  f.close();
+  return count;
+}
+
+bool save_records(fs::FS& fs, const TraceRecord* records, size_t count) {
+  File f = fs.open(kBootTracePath, "w");
+  if (!f) return false;
+  TraceFileHeader hdr{};
+  memcpy(hdr.magic, kTraceMagic, sizeof(hdr.magic));
+  hdr.version = kTraceVersion;
+  hdr.count = static_cast<uint16_t>(count);
+  const size_t bytes = count * sizeof(TraceRecord);
+  const bool ok = f.write(reinterpret_cast<const uint8_t*>(&hdr), sizeof(hdr)) == sizeof(hdr) &&
+                  f.write(reinterpret_cast<const uint8_t*>(records), bytes) == bytes;
+  f.close();
+  return ok;
+}
+} // namespace
+
+void boot_trace_start(bool power_up) {
+  g_active.store(false);
+  for (std::atomic<uint32_t>& t : g_end_us) t.store(kNotReached);
+  g_power_up = power_up;
+  g_start_us = power_up ? 0 : esp_timer_get_time();
+  g_active.store(true);
+}
+
+void boot_trace_mark(BootPhase phase) {
+  if (!g_active.load()) return;
+  const uint32_t t = static_cast<uint32_t>(esp_timer_get_time() - g_start_us);
+  uint32_t expected = kNotReached;
+  g_end_us[static_cast<size_t>(phase)].compare_exchange_strong(expected, t);
+}
+
+void boot_trace_finish(fs::FS* fs) {
+  if (!g_active.exchange(false)) return;
+  // Oldest first, room for the new one at the end.
+  static TraceRecord records[kBootTraceKeep + 1];
+  size_t count = fs ? load_records(*fs, records) : 0;
+  TraceRecord& r = records[count];
+  memset(&r, 0, sizeof(r));
+  r.seq = count ? records[count - 1].seq + 1 : 1;
+  r.power_up = g_power_up ? 1 : 0;
+  for (size_t i = 0; i < kPhases; ++i) r.end_us[i] = g_end_us[i].load();
+  print_record(r);
+  if (!fs) return;
+  ++count;
+  const size_t drop = count > kBootTraceKeep ? count - kBootTraceKeep : 0;
+  save_records(*fs, records + drop, count - drop);
+}
+
+void boot_trace_dump(fs::FS& fs) {
+  static TraceRecord records[kBootTraceKeep];
+  const size_t count = load_records(fs, records);
+  if (count == 0) {
+    DBG_PRINTF("Trace: none kept in %s\n", kBootTracePath);
+    return;
+  }
+  for (size_t i = 0; i < count; ++i) print_record(records[i]);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <FS.h>
+
+// Where the time between a press and the first sample goes. Each phase
+// records when it ended, in microseconds from the start of the trace
+// (esp_timer_get_time(); a power-up trace starts at reset). Phases not
+// reached in a trace are left out; the rest print in the order they ended.
+enum class BootPhase : uint8_t {
+  kRtcBegin,
+  kFsBegin,
+  kFsList,
+  kAppState,
+  kAssets,      // asset index and voice packs
+  kWifiPortal,
+  kI2sSetup,    // I2S output, volume pot and audio task
+  kFirstDecode, // first decoded frames reach the PCM ring
+  kFirstDma,    // first write into the I2S DMA buffers
+  kPowerOff,    // kPinPowerOff released
+  kCount,
+};
+
+// Starts a trace, dropping an unfinished one. power_up counts from reset,
+// otherwise from now (a button press).
+void boot_trace_start(bool power_up);
+// Records the end of a phase in the current trace. Only the first mark of
+// a phase counts; without a trace it does nothing. Safe from any task.
+void boot_trace_mark(BootPhase phase);
+// Prints the current trace and keeps it in kBootTracePath with the last
+// kBootTraceKeep ones (fs may be null to only print).
+void boot_trace_finish(fs::FS* fs);
+// Prints the kept traces, oldest first.
+void boot_trace_dump(fs::FS& fs);
@@ -1,7 +1,6 @@
 #include "serial_cli.h"
 
 #include <Arduino.h>
-#include <LittleFS.h>
 #include <math.h>
 
 #include "app_state.h"
@@ -28,8 +27,8 @@ void speak_time_custom(TimeSpeech& time_speech,
                        uint8_t hour,
                        uint8_t minute,
                        SpeechLanguage lang,
-                       bool fs_ok,
-                       PlayFileFn play_file) {
+                       PlayPlaylistFn play_playlist,
+                       HasClipFn has_clip) {
   RtcDateTime dt{};
   dt.year = 2026;
   dt.month = 1;
@@ -44,9 +43,9 @@ void speak_time_custom(TimeSpeech& time_speech,
     DBG_PRINT("Test path: ");
     DBG_PRINT(playlist[i]);
     DBG_PRINT(" exists=");
-    DBG_PRINTLN((fs_ok && LittleFS.exists(playlist[i])) ? "yes" : "no");
-    play_file(playlist[i]);
+    DBG_PRINTLN(has_clip(playlist[i]) ? "yes" : "no");
   }
+  play_playlist(playlist, count, nullptr);
 }
 
 void speak_date_custom(DateSpeech& date_speech,
@@ -54,7 +53,7 @@ void speak_date_custom(DateSpeech& date_speech,
                        uint8_t month,
                        uint16_t year,
                        SpeechLanguage lang,
-                       PlayFileFn play_file) {
+                       PlayPlaylistFn play_playlist) {
   RtcDateTime dt{};
   dt.year = year;
   dt.month = month;
@@ -65,28 +64,25 @@ void speak_date_custom(DateSpeech& date_speech,
   dt.weekday = weekday_from_ymd(year, month, day);
   const char* playlist[10] = {};
   const size_t count = date_speech.build_playlist_lang(dt, lang, playlist, 10);
-  if (lang == SpeechLanguage::kEnglish && count > 0) {
-    play_file(playlist[0]);
-    delay(100);
-    for (size_t i = 1; i < count; ++i) {
-      play_file(playlist[i]);
-    }
-  } else {
-    for (size_t i = 0; i < count; ++i) {
-      play_file(playlist[i]);
-    }
+  uint16_t pauses_ms[10];
+  for (uint16_t& p : pauses_ms) p = kClipPauseMs;
+  if (lang == SpeechLanguage::kEnglish) {
+    pauses_ms[0] = kWeekdayPauseMs;
   }
+  play_playlist(playlist, count, pauses_ms);
 }
 } // namespace
 
 void serial_cli_handle(TimeSpeech& time_speech,
                        DateSpeech& date_speech,
-                       bool fs_ok,
-                       PlayFileFn play_file,
+                       PlayPlaylistFn play_playlist,
+                       HasClipFn has_clip,
                        GetLanguageFn get_lang,
                        SetLanguageFn set_lang,
                        ReadBatteryFn read_battery,
-                       ReadBatteryAdcFn read_battery_adc) {
+                       ReadBatteryAdcFn read_battery_adc,
+                       RunBenchFn run_bench,
+                       ShowTraceFn show_trace) {
 #if ENABLE_SERIAL_DEBUG
   static String line;
   static bool cal_active = false;
@@ -129,6 +125,13 @@ void serial_cli_handle(TimeSpeech& time_speech,
           DBG_PRINTLN("  CAL        - calibrate ADC (5 points)");
           DBG_PRINTLN("  LANG EN|DE - set default language");
           DBG_PRINTLN("  LANG ?     - show current language");
+          DBG_PRINTLN("  BENCH I2S  - cycles per output second, per-sample vs block writes");
+          DBG_PRINTLN("  BENCH MP3  - decode cycles per frame, full/single-channel/half-rate");
+          DBG_PRINTLN("  BENCH ADPCM - decode cycles per audio second and bytes per clip, MP3 vs IMA ADPCM");
+          DBG_PRINTLN("  BENCH AAC  - decode cycles per audio second and bytes per clip, MP3 vs M4A (/m4a)");
+          DBG_PRINTLN("  BENCH OPUS - decode cycles, bytes per clip and decoder RAM, MP3 vs SILK (/voice_de_opus.vpk)");
+          DBG_PRINTLN("  BENCH RESAMPLE - resampler cycles per output frame, 8/16/32 taps");
+          DBG_PRINTLN("  TRACE      - press-to-first-sample timings of the last presses");
           line = "";
           continue;
         }
@@ -263,6 +266,20 @@ void serial_cli_handle(TimeSpeech& time_speech,
           line = "";
           continue;
         }
+        if (upper == "TRACE") {
+          if (show_trace) show_trace();
+          line = "";
+          continue;
+        }
+        if (upper.startsWith("BENCH")) {
+          String arg = line.substring(5);
+          arg.trim();
+          if (!run_bench || !run_bench(arg.c_str())) {
+            DBG_PRINTLN("BENCH: unknown benchmark");
+          }
+          line = "";
+          continue;
+        }
         if (line.length() >= 4) {
           if (upper.startsWith("LANG")) {
             String arg = line.substring(4);
@@ -296,7 +313,7 @@ void serial_cli_handle(TimeSpeech& time_speech,
           int mm = rest.substring(colon + 1).toInt();
           if (hh >= 0 && hh <= 23 && mm >= 0 && mm <= 59) {
             DBG_PRINTF("Test time %02d:%02d (%c)\n", hh, mm, lang_ch);
-            speak_time_custom(time_speech, static_cast<uint8_t>(hh), static_cast<uint8_t>(mm), lang, fs_ok, play_file);
+            speak_time_custom(time_speech, static_cast<uint8_t>(hh), static_cast<uint8_t>(mm), lang, play_playlist, has_clip);
           }
         } else if (rest.indexOf('.') >= 0) {
           int d1 = rest.indexOf('.');
@@ -312,7 +329,7 @@ void serial_cli_handle(TimeSpeech& time_speech,
                                 static_cast<uint8_t>(mo),
                                 static_cast<uint16_t>(yy),
                                 lang,
-                                play_file);
+                                play_playlist);
             }
           }
         }
@@ -8,17 +8,22 @@
 #include "time_speech.h"
 #include "date_speech.h"
 
-using PlayFileFn = bool (*)(const char* path);
+using PlayPlaylistFn = bool (*)(const char* const* paths, size_t count, const uint16_t* pauses_ms);
+using HasClipFn = bool (*)(const char* path);
 using GetLanguageFn = SpeechLanguage (*)();
 using SetLanguageFn = void (*)(SpeechLanguage lang);
 using ReadBatteryFn = float (*)();
 using ReadBatteryAdcFn = float (*)();
+using RunBenchFn = bool (*)(const char* name);
+using ShowTraceFn = void (*)();
 
 void serial_cli_handle(TimeSpeech& time_speech,
                        DateSpeech& date_speech,
-                       bool fs_ok,
-                       PlayFileFn play_file,
+                       PlayPlaylistFn play_playlist,
+                       HasClipFn has_clip,
                        GetLanguageFn get_lang,
                        SetLanguageFn set_lang,
                        ReadBatteryFn read_battery,
-                       ReadBatteryAdcFn read_battery_adc);
+                       ReadBatteryAdcFn read_battery_adc,
+                       RunBenchFn run_bench,
+                       ShowTraceFn show_trace);
@@ -0,0 +1,151 @@
+#include "voice_pack.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+VoicePack::~VoicePack() {
+  close();
+}
+
+bool VoicePack::open(fs::FS& fs, const char* pack_path, const char* clip_dir) {
+  close();
+  if (!pack_path || !clip_dir) return false;
+  file_ = fs.open(pack_path, "r");
+  if (!file_) return false;
+  file_pos_ = 0;
+  VoicePackHeader hdr{};
+  if (read_at(0, &hdr, sizeof(hdr)) != sizeof(hdr) || !valid_header(hdr, file_.size())) {
+    file_.close();
+    return false;
+  }
+  const uint32_t table_bytes = hdr.clip_count * sizeof(VoicePackEntry);
+  VoicePackEntry* table = static_cast<VoicePackEntry*>(malloc(table_bytes));
+  if (!table || read_at(hdr.table_offset, table, table_bytes) != table_bytes ||
+      !valid_table(table, hdr.clip_count, file_.size())) {
+    free(table);
+    file_.close();
+    return false;
+  }
+  header_ = hdr;
+  table_ = table;
+  clip_dir_ = clip_dir;
+  clip_dir_len_ = strlen(clip_dir);
+  return true;
+}
+
+bool VoicePack::open_mapped(const uint8_t* data, size_t size, const char* clip_dir) {
+  close();
+  if (!data || !clip_dir || size < sizeof(VoicePackHeader)) return false;
+  VoicePackHeader hdr;
+  memcpy(&hdr, data, sizeof(hdr));
+  // The table is used in place, so it has to be aligned for the entry fields.
+  if (!valid_header(hdr, size) || hdr.table_offset % alignof(VoicePackEntry) != 0) return false;
+  const VoicePackEntry* table = reinterpret_cast<const VoicePackEntry*>(data + hdr.table_offset);
+  if (!valid_table(table, hdr.clip_count, size)) return false;
+  mapped_ = data;
+  header_ = hdr;
+  table_ = table;
+  clip_dir_ = clip_dir;
+  clip_dir_len_ = strlen(clip_dir);
+  return true;
+}
+
+bool VoicePack::valid_header(const VoicePackHeader& hdr, size_t size) {
+  return memcmp(hdr.magic, kVoicePackMagic, sizeof(hdr.magic)) == 0 &&
+         hdr.version == kVoicePackVersion &&
+         (hdr.codec == static_cast<uint16_t>(VoicePackCodec::kMp3) ||
+          hdr.codec == static_cast<uint16_t>(VoicePackCodec::kAacAdts) ||
+          hdr.codec == static_cast<uint16_t>(VoicePackCodec::kImaAdpcm) ||
+          hdr.codec == static_cast<uint16_t>(VoicePackCodec::kOpusSilk)) &&
+         hdr.clip_count > 0 && hdr.table_offset <= size &&
+         hdr.clip_count <= (size - hdr.table_offset) / sizeof(VoicePackEntry);
+}
+
+// Clips are read without bounds checks later, so check them all once here.
+bool VoicePack::valid_table(const VoicePackEntry* table, uint32_t count, size_t size) {
+  for (uint32_t i = 0; i < count; ++i) {
+    if (table[i].offset > size || table[i].length > size - table[i].offset) return false;
+  }
+  return true;
+}
+
+void VoicePack::close() {
+  if (!mapped_) free(const_cast<VoicePackEntry*>(table_));
+  mapped_ = nullptr;
+  table_ = nullptr;
+  header_ = VoicePackHeader{};
+  if (file_) file_.close();
+}
+
+bool VoicePack::find(const char* clip_path, VoicePackEntry* entry) const {
+  if (!table_ || !clip_path) return false;
+  // "<clip_dir>/<name>.<ext>" -> "<name>"
+  if (strncmp(clip_path, clip_dir_, clip_dir_len_) != 0 || clip_path[clip_dir_len_] != '/') return false;
+  const char* name = clip_path + clip_dir_len_ + 1;
+  const char* dot = strrchr(name, '.');
+  const size_t len = dot ? static_cast<size_t>(dot - name) : strlen(name);
+  const uint32_t id = voice_pack_clip_id(name, len);
+
+  size_t lo = 0;
+  size_t hi = header_.clip_count;
+  while (lo < hi) {
+    const size_t mid = (lo + hi) / 2;
+    if (table_[mid].id < id) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  if (lo == header_.clip_count || table_[lo].id != id) return false;
+  if (entry) *entry = table_[lo];
+  return true;
+}
+
+uint32_t VoicePack::read_at(uint32_t offset, void* data, uint32_t len) {
+  if (mapped_) {
+    memcpy(data, mapped_ + offset, len);
+    return len;
+  }
+  if (offset != file_pos_) {
+    if (!file_.seek(offset, fs::SeekSet)) return 0;
+    file_pos_ = offset;
+  }
+  const uint32_t got = file_.read(static_cast<uint8_t*>(data), len);
+  file_pos_ += got;
+  return got;
+}
+
+bool VoicePackSource::begin(VoicePack* pack, const VoicePackEntry& entry) {
+  pack_ = (pack && pack->is_open()) ? pack : nullptr;
+  offset_ = entry.offset;
+  length_ = entry.length;
+  pos_ = 0;
+  return pack_ != nullptr;
+}
+
+uint32_t VoicePackSource::read(void* data, uint32_t len) {
+  if (!pack_ || pos_ >= length_) return 0;
+  if (len > length_ - pos_) len = length_ - pos_;
+  const uint32_t got = pack_->read_at(offset_ + pos_, data, len);
+  pos_ += got;
+  return got;
+}
+
+bool VoicePackSource::seek(int32_t pos, int dir) {
+  if (!pack_) return false;
+  int32_t target = pos;
+  if (dir == SEEK_CUR) target += static_cast<int32_t>(pos_);
+  if (dir == SEEK_END) target += static_cast<int32_t>(length_);
+  if (target < 0 || static_cast<uint32_t>(target) > length_) return false;
+  pos_ = static_cast<uint32_t>(target);
+  return true;
+}
+
+const uint8_t* VoicePackSource::getMapped() {
+  return (pack_ && pack_->mapped_) ? pack_->mapped_ + offset_ : nullptr;
+}
+
+bool VoicePackSource::close() {
+  pack_ = nullptr;
+  return true;
+}
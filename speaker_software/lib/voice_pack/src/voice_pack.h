@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <AudioFileSource.h>
+#include <FS.h>
+
+#include "voice_pack_format.h"
+
+// One open voice pack. Clips are looked up by their playlist path
+// ("/mp3/01_Uhr.mp3") and read through VoicePackSource, which shares the
+// pack's single file handle instead of opening a file per clip. A pack
+// opened from a memory mapping (see voice_pack_map.h) needs no handle at
+// all: its table and clips are used in place.
+class VoicePack {
+ public:
+  ~VoicePack();
+
+  // clip_dir is the playlist directory the pack stands in for, e.g. "/mp3".
+  bool open(fs::FS& fs, const char* pack_path, const char* clip_dir);
+  // data must stay mapped until close(); size may include trailing padding.
+  bool open_mapped(const uint8_t* data, size_t size, const char* clip_dir);
+  void close();
+  bool is_open() const { return table_ != nullptr; }
+
+  bool find(const char* clip_path, VoicePackEntry* entry) const;
+  size_t clip_count() const { return header_.clip_count; }
+  uint32_t sample_rate() const { return header_.sample_rate; }
+  VoicePackCodec codec() const { return static_cast<VoicePackCodec>(header_.codec); }
+  bool is_mapped() const { return mapped_ != nullptr; }
+
+ private:
+  friend class VoicePackSource;
+  static bool valid_header(const VoicePackHeader& hdr, size_t size);
+  static bool valid_table(const VoicePackEntry* table, uint32_t count, size_t size);
+  uint32_t read_at(uint32_t offset, void* data, uint32_t len);
+
+  fs::File file_;
+  const uint8_t* mapped_ = nullptr;
+  VoicePackHeader header_{};
+  const VoicePackEntry* table_ = nullptr; // malloc'd, or inside mapped_
+  const char* clip_dir_ = nullptr;
+  size_t clip_dir_len_ = 0;
+  uint32_t file_pos_ = 0; // where file_ is positioned, to skip redundant seeks
+};
+
+// AudioFileSource over one clip of an open VoicePack. Several sources may
+// read the same pack alternately (e.g. two decoder slots); each keeps its
+// own position and the pack seeks only when they interleave. Clips of a
+// mapped pack are handed to the decoder in place through getMapped().
+class VoicePackSource : public AudioFileSource {
+ public:
+  bool begin(VoicePack* pack, const VoicePackEntry& entry);
+
+  uint32_t read(void* data, uint32_t len) override;
+  bool seek(int32_t pos, int dir) override;
+  bool close() override;
+  bool isOpen() override { return pack_ != nullptr; }
+  uint32_t getSize() override { return length_; }
+  uint32_t getPos() override { return pos_; }
+  const uint8_t* getMapped() override;
+
+ private:
+  VoicePack* pack_ = nullptr;
+  uint32_t offset_ = 0;
+  uint32_t length_ = 0;
+  uint32_t pos_ = 0;
+};
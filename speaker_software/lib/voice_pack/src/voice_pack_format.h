@@ -0,0 +1,65 @@
+#pragma once
+
+// On-disk layout of a voice pack: all clips of one language in one file.
+// Shared by the firmware reader and the host packer. Little endian.
+//
+//   VoicePackHeader
+//   VoicePackEntry[clip_count]   sorted by id
+//   payloads                     concatenated, each 4-byte aligned
+//
+// skip/samples count the output of the firmware's own decoder (vendored
+// libmad / libhelix-aac, decoding errors skipped), which the packer runs
+// on every payload it writes. ADPCM and Opus clips are re-encoded from
+// exactly the speech: an ADPCM skip is 0, an Opus skip the codec delay.
+// gain is the loudness correction left after the packer's own leveling,
+// applied by the player's output gain stage.
+
+#include <stddef.h>
+#include <stdint.h>
+
+constexpr char kVoicePackMagic[4] = {'V', 'P', 'K', '1'};
+constexpr uint16_t kVoicePackVersion = 3;
+// Speech loudness (gated RMS) every clip is brought to, packed or measured on the device
+constexpr float kVoicePackLoudnessDb = -16.0f;
+constexpr uint16_t kVoicePackUnityGain = 32768; // Q15
+
+enum class VoicePackCodec : uint16_t {
+  kMp3 = 1,
+  kAacAdts = 2,            // AAC-LC access units, each behind an ADTS header
+  kImaAdpcm = 3,           // mono 4-bit IMA ADPCM WAV file per clip, cut to the speech
+  kOpusSilk = 4,           // mono SILK-only Opus packets at 16 kHz, each behind a 2-byte length
+};
+
+struct VoicePackHeader {
+  char magic[4];
+  uint16_t version;
+  uint16_t codec;          // VoicePackCodec
+  uint32_t clip_count;
+  uint32_t table_offset;   // first VoicePackEntry
+  uint32_t data_offset;    // first payload byte
+  uint32_t sample_rate;    // shared by all clips
+};
+
+struct VoicePackEntry {
+  uint32_t id;             // voice_pack_clip_id() of the clip name
+  uint32_t offset;         // payload start, from the start of the file
+  uint32_t length;         // payload bytes, tags already stripped
+  uint32_t skip;           // decoded samples before the speech starts
+  uint32_t samples;        // speech samples after skip, at sample_rate
+  uint16_t gain;           // Q15 playback gain, kVoicePackUnityGain = as stored
+  uint16_t reserved;
+};
+
+static_assert(sizeof(VoicePackHeader) == 24, "VoicePackHeader layout");
+static_assert(sizeof(VoicePackEntry) == 24, "VoicePackEntry layout");
+
+// Clip ids are the FNV-1a hash of the file name without directory and
+// extension ("/mp3/01_Uhr.mp3" -> "01_Uhr"); the packer rejects collisions.
+inline uint32_t voice_pack_clip_id(const char* name, size_t len) {
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < len; ++i) {
+    h ^= static_cast<uint8_t>(name[i]);
+    h *= 16777619u;
+  }
+  return h;
+}
@@ -0,0 +1,57 @@
+#include "voice_pack_map.h"
+
+#ifdef ESP32
+#include <esp_partition.h>
+#include <esp_spi_flash.h>
+
+bool voice_pack_map(const char* name, VoicePackMapping* mapping) {
+  if (!name || !mapping) return false;
+  const esp_partition_t* part = esp_partition_find_first(
+      ESP_PARTITION_TYPE_DATA, static_cast<esp_partition_subtype_t>(kVoicePackPartitionSubtype), name);
+  if (!part) return false;
+  const void* data = nullptr;
+  spi_flash_mmap_handle_t handle = 0;
+  if (esp_partition_mmap(part, 0, part->size, SPI_FLASH_MMAP_DATA, &data, &handle) != ESP_OK) {
+    return false;
+  }
+  mapping->data = static_cast<const uint8_t*>(data);
+  mapping->size = part->size;
+  mapping->handle = handle;
+  return true;
+}
+
+void voice_pack_unmap(VoicePackMapping* mapping) {
+  if (!mapping || !mapping->data) return;
+  spi_flash_munmap(mapping->handle);
+  *mapping = VoicePackMapping{};
+}
+
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool voice_pack_map(const char* name, VoicePackMapping* mapping) {
+  if (!name || !mapping) return false;
+  const int fd = open(name, O_RDONLY);
+  if (fd < 0) return false;
+  struct stat st;
+  void* data = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+    data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+  }
+  close(fd); // the mapping keeps the file referenced
+  if (data == MAP_FAILED) return false;
+  mapping->data = static_cast<const uint8_t*>(data);
+  mapping->size = static_cast<size_t>(st.st_size);
+  mapping->handle = 0;
+  return true;
+}
+
+void voice_pack_unmap(VoicePackMapping* mapping) {
+  if (!mapping || !mapping->data) return;
+  munmap(const_cast<uint8_t*>(mapping->data), mapping->size);
+  *mapping = VoicePackMapping{};
+}
+#endif
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Read-only memory mapping of a voice pack image, for VoicePack::open_mapped().
+// On the ESP32 the name is the label of a raw data partition (subtype
+// kVoicePackPartitionSubtype) the pack was flashed into, and the mapping goes
+// through the flash MMU/cache. On a host build it is a file path.
+constexpr uint8_t kVoicePackPartitionSubtype = 0x40;
+
+struct VoicePackMapping {
+  const uint8_t* data = nullptr;
+  size_t size = 0;
+  uint32_t handle = 0;
+};
+
+bool voice_pack_map(const char* name, VoicePackMapping* mapping);
+void voice_pack_unmap(VoicePackMapping* mapping);
@@ -0,0 +1,48 @@
+#include "volume_pot.h"
+
+#include <Arduino.h>
+
+namespace {
+// Each reading moves the filter 1/8 of the way: ~160 ms time constant at 20 ms polls.
+constexpr uint32_t kFilterShift = 3;
+constexpr uint32_t kAdcMax = 4095;
+
+uint32_t to_q15(float gain) {
+  if (gain < 0.0f) gain = 0.0f;
+  if (gain > 1.0f) gain = 1.0f;
+  return static_cast<uint32_t>(gain * 32768.0f + 0.5f);
+}
+} // namespace
+
+bool VolumePot::begin(uint8_t pin, uint32_t period_ms, float gain_min, float gain_max) {
+  if (timer_) return false;
+  pin_ = pin;
+  min_q15_ = to_q15(gain_min);
+  const uint32_t max_q15 = to_q15(gain_max);
+  span_q15_ = max_q15 > min_q15_ ? max_q15 - min_q15_ : 0;
+  pinMode(pin_, INPUT);
+  filtered_ = static_cast<uint32_t>(analogRead(pin_)) << kFilterShift;
+  sample();
+
+  esp_timer_create_args_t args = {};
+  args.callback = &VolumePot::on_timer;
+  args.arg = this;
+  args.name = "volume_pot";
+  if (esp_timer_create(&args, &timer_) != ESP_OK) {
+    timer_ = nullptr;
+    return false;
+  }
+  return esp_timer_start_periodic(timer_, static_cast<uint64_t>(period_ms) * 1000) == ESP_OK;
+}
+
+void VolumePot::on_timer(void* arg) {
+  static_cast<VolumePot*>(arg)->sample();
+}
+
+void VolumePot::sample() {
+  const uint32_t raw = static_cast<uint32_t>(analogRead(pin_));
+  filtered_ += raw - (filtered_ >> kFilterShift);
+  uint32_t pos = filtered_ >> kFilterShift;
+  if (pos > kAdcMax) pos = kAdcMax;
+  gain_q15_.store(static_cast<uint16_t>(min_q15_ + span_q15_ * pos / kAdcMax));
+}
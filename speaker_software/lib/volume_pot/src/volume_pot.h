@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+
+#include <esp_timer.h>
+
+// Volume potentiometer on an ADC pin. A periodic esp_timer samples it and
+// runs the readings through a first-order low-pass filter, so ADC noise
+// never reaches the output and readers never wait on the ADC.
+class VolumePot {
+ public:
+  // Seeds the filter with one reading, then samples every period_ms.
+  bool begin(uint8_t pin, uint32_t period_ms, float gain_min, float gain_max);
+  // Filtered position mapped linearly onto [gain_min, gain_max], Q15. Any task.
+  uint16_t gain_q15() const { return gain_q15_.load(); }
+
+ private:
+  static void on_timer(void* arg);
+  void sample();
+
+  uint8_t pin_ = 0;
+  esp_timer_handle_t timer_ = nullptr;
+  uint32_t filtered_ = 0; // ADC reading scaled by 1 << kFilterShift
+  uint32_t min_q15_ = 0;
+  uint32_t span_q15_ = 0;
+  std::atomic<uint16_t> gain_q15_{0};
+};
@@ -3,8 +3,6 @@
 #include "board_pins.h"
 #include "project_config.h"
 
-#include <AudioFileSourceFS.h>
-#include <AudioGeneratorMP3.h>
 #include <AudioOutputI2S.h>
 #include <LittleFS.h>
 
@@ -15,6 +13,14 @@
 #include "wifi_portal.h"
 #include "app_state.h"
 #include "serial_cli.h"
+#include "announcement_player.h"
+#include "audio_task.h"
+#include "audio_bench.h"
+#include "asset_index.h"
+#include "boot_trace.h"
+#include "voice_pack.h"
+#include "voice_pack_map.h"
+#include "volume_pot.h"
 
 #if ENABLE_SERIAL_DEBUG
 #define DBG_BEGIN(...) Serial.begin(__VA_ARGS__)
@@ -38,9 +44,13 @@ bool g_fs_ok = false;
 TimeSpeech g_time_speech;
 DateSpeech g_date_speech;
 AudioOutputI2S* g_out = nullptr;
+AnnouncementPlayer g_player(LittleFS);
+PcmCache g_pcm_cache;
+VoicePack g_pack_de;
+VoicePack g_pack_en;
+AudioTask g_audio_task;
 WifiPortal g_wifi_portal;
-hw_timer_t* g_gain_timer = nullptr;
-volatile bool g_gain_update_due = false;
+VolumePot g_volume_pot;
 
 uint32_t rtc_to_epoch_utc(const RtcDateTime& utc_dt) {
   const int y = static_cast<int>(utc_dt.year);
@@ -78,10 +88,6 @@ bool rtc_now_cb(uint32_t* epoch_utc, const char** tz_posix) {
   return true;
 }
 
-void IRAM_ATTR on_gain_timer() {
-  g_gain_update_due = true;
-}
-
 float read_battery_adc_voltage() {
   const int raw = analogRead(kPinBatteryAdc);
   return (static_cast<float>(raw) / 4095.0f) * 3.3f;
@@ -96,10 +102,8 @@ float read_battery_voltage() {
   return a * v_adc * v_adc + b * v_adc + c;
 }
 
-float read_volume_gain() {
-  const int raw = analogRead(kPinVolumePotAdc);
-  const float norm = static_cast<float>(raw) / 4095.0f;
-  return kMp3GainMin + (kMp3GainMax - kMp3GainMin) * norm;
+void service_audio() {
+  g_audio_task.set_gain(g_volume_pot.gain_q15());
 }
 
 void set_rtc_from_browser(uint64_t epoch_ms, int16_t tz_offset_min) {
@@ -112,6 +116,7 @@ void set_rtc_from_browser(uint64_t epoch_ms, int16_t tz_offset_min) {
 }
 
 bool play_mp3_file(const char* path);
+bool play_playlist(const char* const* paths, size_t count, const uint16_t* pauses_ms = nullptr);
 void play_wifi_on() {
   play_mp3_file("/mp3/wifi_on.mp3");
 }
@@ -126,11 +131,7 @@ void speak_time_once() {
   const RtcDateTime local = to_local_time(rtc_dt);
   const char* playlist[4] = {};
   const size_t count = g_time_speech.build_playlist_lang(local, current_language(), playlist, 4);
-  for (size_t i = 0; i < count; ++i) {
-    DBG_PRINT("Play: ");
-    DBG_PRINTLN(playlist[i]);
-    play_mp3_file(playlist[i]);
-  }
+  play_playlist(playlist, count);
 }
 
 void speak_date_once() {
@@ -142,47 +143,100 @@ void speak_date_once() {
   const RtcDateTime local = to_local_time(rtc_dt);
   const char* playlist[6] = {};
   const size_t count = g_date_speech.build_playlist_lang(local, current_language(), playlist, 6);
-  if (current_language() == SpeechLanguage::kEnglish && count > 0) {
-    play_mp3_file(playlist[0]);
-    delay(100);
-    for (size_t i = 1; i < count; ++i) {
-      play_mp3_file(playlist[i]);
-    }
-  } else {
-    for (size_t i = 0; i < count; ++i) {
-      play_mp3_file(playlist[i]);
-    }
+  uint16_t pauses_ms[6];
+  for (uint16_t& p : pauses_ms) p = kClipPauseMs;
+  if (current_language() == SpeechLanguage::kEnglish) {
+    pauses_ms[0] = kWeekdayPauseMs;
   }
+  play_playlist(playlist, count, pauses_ms);
 }
 
-bool play_mp3_file(const char* path) {
-  if (!path || !g_fs_ok) return false;
-  if (!LittleFS.exists(path)) {
-    DBG_PRINT("Missing: ");
-    DBG_PRINTLN(path);
-    return false;
+// Hands the playlist to the audio task and blocks until it has played out.
+bool play_playlist(const char* const* paths, size_t count, const uint16_t* pauses_ms) {
+  if (!g_fs_ok) return false;
+  if (!g_audio_task.play(paths, count, pauses_ms)) return false;
+  const bool ok = g_audio_task.wait();
+  if (g_pcm_cache.enabled()) {
+    const PcmCache::Stats st = g_pcm_cache.stats();
+    DBG_PRINTF("PCM cache: %u hits, %u misses, %u evictions, %u clips, %u bytes\n",
+               st.hits, st.misses, st.evictions, st.clips, static_cast<unsigned>(st.bytes));
   }
-  DBG_PRINT("Open: ");
-  DBG_PRINTLN(path);
-  AudioFileSourceFS file(LittleFS, path);
-  AudioGeneratorMP3 mp3;
-  if (!g_out) return false;
-  if (!mp3.begin(&file, g_out)) {
-    DBG_PRINT("MP3 begin failed: ");
-    DBG_PRINTLN(path);
-    return false;
+  return ok;
+}
+
+bool has_clip(const char* path) {
+  return g_fs_ok && g_player.has_clip(path);
+}
+
+bool run_bench(const char* name) {
+  return audio_bench_run(name, g_out);
+}
+
+void show_trace() {
+  if (g_fs_ok) boot_trace_dump(LittleFS);
+}
+
+// Where finished traces are kept; null prints them only.
+fs::FS* trace_fs() {
+  return (kBootTraceStore && g_fs_ok) ? &LittleFS : nullptr;
+}
+
+// Ends the press. A stored trace has to be written while the latch still
+// holds the supply; otherwise the latch goes first and the trace is printed
+// for as long as USB or the decaying rail keeps the chip alive.
+void release_power() {
+  boot_trace_mark(BootPhase::kPowerOff);
+  if (kBootTraceStore) {
+    boot_trace_finish(trace_fs());
+    digitalWrite(kPinPowerOff, HIGH);
+  } else {
+    digitalWrite(kPinPowerOff, HIGH);
+    boot_trace_finish(nullptr);
   }
-  while (mp3.isRunning()) {
-    if (g_gain_update_due) {
-      g_gain_update_due = false;
-      if (g_out) {
-        g_out->SetGain(read_volume_gain());
-      }
+}
+
+// Speaks the time, and the date too if the last press was under 20 s ago,
+// then lets the power latch go.
+void announce(const char* source) {
+  uint32_t prev_epoch = 0;
+  const bool has_prev = load_last_time(&prev_epoch);
+  RtcDateTime rtc_dt{};
+  if (!g_rtc.read_datetime(&rtc_dt)) return;
+  const uint32_t now_epoch = rtc_to_epoch_utc(rtc_dt);
+  const uint32_t diff = has_prev ? (now_epoch - prev_epoch) : 0;
+  DBG_PRINTF("Time delta (%s) = %u s\n", source, diff);
+  const bool do_date = has_prev && (diff <= 20);
+  speak_time_once();
+  if (do_date) {
+    delay(kTimeDatePauseMs);
+    speak_date_once();
+  }
+  save_last_time(now_epoch);
+  release_power();
+}
+
+bool play_mp3_file(const char* path) {
+  if (!path) return false;
+  return play_playlist(&path, 1);
+}
+
+void open_voice_pack(VoicePack& pack, const char* partition, const char* pack_path, const char* clip_dir) {
+  // A flashed partition is decoded straight out of the flash mapping, without file reads.
+  VoicePackMapping mapping;
+  if (voice_pack_map(partition, &mapping)) {
+    if (pack.open_mapped(mapping.data, mapping.size, clip_dir) && g_player.add_voice_pack(&pack)) {
+      DBG_PRINTF("Voice pack %s (mapped): %u clips\n", partition, static_cast<unsigned>(pack.clip_count()));
+      return;
     }
-    if (!mp3.loop()) mp3.stop();
-    delay(1);
+    pack.close();
+    voice_pack_unmap(&mapping); // partition present but not flashed
+  }
+  if (!g_fs_ok || !LittleFS.exists(pack_path)) return;
+  if (pack.open(LittleFS, pack_path, clip_dir) && g_player.add_voice_pack(&pack)) {
+    DBG_PRINTF("Voice pack %s: %u clips\n", pack_path, static_cast<unsigned>(pack.clip_count()));
+  } else {
+    DBG_PRINTF("Voice pack %s invalid\n", pack_path);
   }
-  return true;
 }
 
 void list_littlefs_root() {
@@ -207,73 +261,112 @@ void list_littlefs_root() {
   root.close();
 }
 
-void setup() {
-  DBG_BEGIN(115200);
-  DBG_WAIT_FOR_SERIAL(2000);
-  DBG_PRINTLN("Speaking Clock boot");
+void build_asset_index() {
+  if (asset_index_begin(LittleFS)) {
+    DBG_PRINTF("Asset index: %u clips\n", static_cast<unsigned>(asset_index_count()));
+  } else {
+    DBG_PRINTLN("Asset index build failed");
+  }
+}
+
+// The current language plays from a voice pack, which carries its own trims
+// and gains, so the first announcement needs no asset index.
+bool pack_covers_language() {
+  const VoicePack& pack = (current_language() == SpeechLanguage::kEnglish) ? g_pack_en : g_pack_de;
+  return pack.is_open();
+}
 
+// Everything the first announcement needs: clock, file system, state, voice
+// packs and the audio path.
+void boot_speak_path() {
   if (!g_rtc.begin()) {
     DBG_PRINTLN("RTC init failed");
   }
+  boot_trace_mark(BootPhase::kRtcBegin);
 
   g_fs_ok = LittleFS.begin(false);
+  boot_trace_mark(BootPhase::kFsBegin);
   if (!g_fs_ok) {
     DBG_PRINTLN("LittleFS init failed");
   } else {
     DBG_PRINTLN("LittleFS init OK");
-    list_littlefs_root();
     app_state_begin(g_fs_ok);
+    boot_trace_mark(BootPhase::kAppState);
+  }
+  open_voice_pack(g_pack_de, kVoicePartitionDe, kVoicePackPathDe, kAudioBasePathDe);
+  open_voice_pack(g_pack_en, kVoicePartitionEn, kVoicePackPathEn, kAudioBasePathEn);
+  // Loose clips are trimmed from the index, so it cannot wait for them.
+  if (g_fs_ok && !pack_covers_language()) build_asset_index();
+  boot_trace_mark(BootPhase::kAssets);
+
+  g_out = new AudioOutputI2S();
+  g_out->SetPinout(kPinI2sBclk, kPinI2sLrc, kPinI2sData);
+  g_out->SetChannels(1);
+  g_out->SetMonoFrames(true);
+  // The audio task applies the volume; I2S stays at unity gain.
+  if (!g_volume_pot.begin(kPinVolumePotAdc, kVolumePollMs, kMp3GainMin, kMp3GainMax)) {
+    DBG_PRINTLN("Volume pot timer start failed");
+  }
+  g_audio_task.set_gain(g_volume_pot.gain_q15());
+  g_audio_task.set_service_callback(service_audio);
+  if (!g_audio_task.begin(&g_player, g_out, kAudioTaskCore)) {
+    DBG_PRINTLN("Audio task start failed");
+  }
+  boot_trace_mark(BootPhase::kI2sSetup);
+}
+
+// The rest of the boot, once the announcement is out (or first thing on the
+// config path): nothing here is needed to speak.
+void boot_deferred() {
+  if (g_fs_ok) {
+    list_littlefs_root();
+    boot_trace_mark(BootPhase::kFsList);
+    if (!asset_index_ready()) build_asset_index();
   }
 
   g_wifi_portal.begin();
   g_wifi_portal.set_rtc_callback(set_rtc_from_browser);
   g_wifi_portal.set_rtc_now_callback(rtc_now_cb);
   g_wifi_portal.set_battery_callback(read_battery_voltage);
+  boot_trace_mark(BootPhase::kWifiPortal);
 
-  g_out = new AudioOutputI2S();
-  g_out->SetPinout(kPinI2sBclk, kPinI2sLrc, kPinI2sData);
-  g_out->SetChannels(1);
-  g_out->SetOutputModeMono(true);
-  g_out->SetGain(read_volume_gain());
+  if (g_pcm_cache.begin(kPcmCacheBytes)) {
+    g_player.set_cache(&g_pcm_cache);
+  } else {
+    DBG_PRINTLN("PCM cache disabled (no PSRAM)");
+  }
+
+  DBG_PRINTF("Flash size: %u bytes\n", ESP.getFlashChipSize());
+  DBG_PRINTF("PSRAM size: %u bytes\n", ESP.getPsramSize());
+}
+
+void setup() {
+  boot_trace_start(true);
+  DBG_BEGIN(115200);
 
   pinMode(kPinTriggerButton, INPUT_PULLUP);
   pinMode(kPinConfigButton, INPUT_PULLUP);
   pinMode(kPinBatteryAdc, INPUT);
-  pinMode(kPinVolumePotAdc, INPUT);
   pinMode(kPinPowerOff, OUTPUT);
   digitalWrite(kPinPowerOff, LOW);
-  
-  DBG_PRINTF("Flash size: %u bytes\n", ESP.getFlashChipSize());
-  DBG_PRINTF("PSRAM size: %u bytes\n", ESP.getPsramSize());
 
-  g_gain_timer = timerBegin(0, 80, true);
-  if (g_gain_timer) {
-    timerAttachInterrupt(g_gain_timer, &on_gain_timer, true);
-    timerAlarmWrite(g_gain_timer, 200000, true);
-    timerAlarmEnable(g_gain_timer);
+  const bool cfg_pressed = (digitalRead(kPinConfigButton) == LOW);
+  if (cfg_pressed) {
+    // Nobody is waiting for the time here; give a monitor the chance to attach.
+    DBG_WAIT_FOR_SERIAL(2000);
   }
+  DBG_PRINTLN("Speaking Clock boot");
 
-  const bool cfg_pressed = (digitalRead(kPinConfigButton) == LOW);
+  boot_speak_path();
   if (cfg_pressed) {
+    boot_deferred();
     play_wifi_on();
+    boot_trace_finish(trace_fs());
     g_wifi_portal.start();
   } else {
-    uint32_t prev_epoch = 0;
-    const bool has_prev = load_last_time(&prev_epoch);
-    RtcDateTime rtc_dt{};
-    if (g_rtc.read_datetime(&rtc_dt)) {
-      const uint32_t now_epoch = rtc_to_epoch_utc(rtc_dt);
-      const uint32_t diff = has_prev ? (now_epoch - prev_epoch) : 0;
-      DBG_PRINTF("Time delta (startup) = %u s\n", diff);
-      const bool do_date = has_prev && (diff <= 20);
-      speak_time_once();
-      if (do_date) {
-        delay(500);
-        speak_date_once();
-      }
-      save_last_time(now_epoch);
-      digitalWrite(kPinPowerOff, HIGH);
-    }
+    announce("startup");
+    // Still powered (USB, or the latch held): finish the boot for the serial CLI.
+    boot_deferred();
   }
 }
 
@@ -283,33 +376,21 @@ void loop() {
 
   if (prev_time_state == HIGH && time_state == LOW) {
     DBG_PRINTLN("Button: TIME");
-    uint32_t prev_epoch = 0;
-    const bool has_prev = load_last_time(&prev_epoch);
-    RtcDateTime rtc_dt{};
-    if (g_rtc.read_datetime(&rtc_dt)) {
-      const uint32_t now_epoch = rtc_to_epoch_utc(rtc_dt);
-      const uint32_t diff = has_prev ? (now_epoch - prev_epoch) : 0;
-      DBG_PRINTF("Time delta (trigger) = %u s\n", diff);
-      const bool do_date = has_prev && (diff <= 20);
-      speak_time_once();
-      if (do_date) {
-        delay(500);
-        speak_date_once();
-      }
-      save_last_time(now_epoch);
-      digitalWrite(kPinPowerOff, HIGH);
-    }
+    boot_trace_start(false);
+    announce("trigger");
   }
 
   prev_time_state = time_state;
 
   serial_cli_handle(g_time_speech,
                     g_date_speech,
-                    g_fs_ok,
-                    play_mp3_file,
+                    play_playlist,
+                    has_clip,
                     current_language,
                     set_language,
                     read_battery_voltage,
-                    read_battery_adc_voltage);
+                    read_battery_adc_voltage,
+                    run_bench,
+                    show_trace);
   g_wifi_portal.loop();
 }
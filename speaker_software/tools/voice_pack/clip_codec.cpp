@@ -0,0 +1,381 @@
+#include "clip_codec.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+
+#include "libhelix-aac/aacdec.h"
+#include "libima/ima_adpcm.h"
+#include "libmad/config.h"
+#include "libmad/mad.h"
+#include "libopus/opus.h"
+#include "libopus/opus_private.h"
+#include "mp4_demux.h"
+
+namespace {
+// 505 samples, 21 ms at 24 kHz; the header costs 1.6 % of the data.
+constexpr uint16_t kAdpcmBlockBytes = 256;
+// The TOC byte and the length cost 3 bytes per packet, 0.4 kbps at 60 ms.
+constexpr int kOpusPacketMs = 60;
+
+struct FrameInfo {
+  uint32_t bytes;
+  uint32_t sample_rate;
+  bool mpeg1;
+  bool mono;
+  bool crc;
+};
+
+// Parses a Layer III frame header; false if `p` is not one.
+bool parse_frame(const uint8_t* p, size_t avail, FrameInfo* info) {
+  static const uint16_t kBitrateV1[16] = {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 0};
+  static const uint16_t kBitrateV2[16] = {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, 0};
+  static const uint32_t kRates[3] = {44100, 48000, 32000};
+  if (avail < 4 || p[0] != 0xff || (p[1] & 0xe0) != 0xe0) return false;
+  const int version = (p[1] >> 3) & 3; // 0 = 2.5, 2 = 2, 3 = 1
+  const int layer = (p[1] >> 1) & 3;   // 1 = Layer III
+  const int bitrate_index = (p[2] >> 4) & 15;
+  const int rate_index = (p[2] >> 2) & 3;
+  if (version == 1 || layer != 1 || bitrate_index == 0 || bitrate_index == 15 || rate_index == 3) return false;
+  info->mpeg1 = (version == 3);
+  info->sample_rate = kRates[rate_index] >> (info->mpeg1 ? 0 : (version == 2 ? 1 : 2));
+  const uint32_t kbps = info->mpeg1 ? kBitrateV1[bitrate_index] : kBitrateV2[bitrate_index];
+  const uint32_t padding = (p[2] >> 1) & 1;
+  info->bytes = (info->mpeg1 ? 144000 : 72000) * kbps / info->sample_rate + padding;
+  info->mono = ((p[3] >> 6) & 3) == 3;
+  info->crc = !(p[1] & 1);
+  return true;
+}
+
+size_t side_info_offset(const FrameInfo& f) {
+  return 4 + (f.crc ? 2 : 0);
+}
+
+size_t side_info_bytes(const FrameInfo& f) {
+  return f.mpeg1 ? (f.mono ? 17 : 32) : (f.mono ? 9 : 17);
+}
+
+// LAME/Xing VBR headers live in an otherwise empty first frame.
+bool is_vbr_header_frame(const std::vector<uint8_t>& frame, const FrameInfo& f) {
+  const size_t xing = side_info_offset(f) + side_info_bytes(f);
+  const size_t vbri = 4 + 32;
+  return (frame.size() >= xing + 4 &&
+          (memcmp(&frame[xing], "Xing", 4) == 0 || memcmp(&frame[xing], "Info", 4) == 0)) ||
+         (frame.size() >= vbri + 4 && memcmp(&frame[vbri], "VBRI", 4) == 0);
+}
+
+uint32_t id3v2_size(const std::vector<uint8_t>& d) {
+  if (d.size() < 10 || memcmp(d.data(), "ID3", 3) != 0) return 0;
+  uint32_t size = ((d[6] & 0x7f) << 21) | ((d[7] & 0x7f) << 14) | ((d[8] & 0x7f) << 7) | (d[9] & 0x7f);
+  size += 10;
+  if (d[5] & 0x10) size += 10;
+  return size;
+}
+
+std::vector<uint8_t> read_file(const std::filesystem::path& path) {
+  std::ifstream in(path, std::ios::binary);
+  return std::vector<uint8_t>((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+uint32_t get_bits(const uint8_t* p, size_t bit, int n) {
+  uint32_t v = 0;
+  for (int i = 0; i < n; ++i, ++bit) v = (v << 1) | ((p[bit >> 3] >> (7 - (bit & 7))) & 1);
+  return v;
+}
+
+void put_bits(uint8_t* p, size_t bit, int n, uint32_t v) {
+  for (int i = n - 1; i >= 0; --i, ++bit) {
+    const uint8_t mask = static_cast<uint8_t>(0x80 >> (bit & 7));
+    p[bit >> 3] = static_cast<uint8_t>((v >> i) & 1 ? (p[bit >> 3] | mask) : (p[bit >> 3] & ~mask));
+  }
+}
+
+// Bit positions of the 8-bit global_gain fields of one frame.
+std::vector<size_t> global_gain_bits(const CodedClip& clip, const std::vector<uint8_t>& frame) {
+  std::vector<size_t> bits;
+  if (clip.codec == VoicePackCodec::kAacAdts) {
+    // raw_data_block: a single channel element is id (3 bits, 0), tag (4 bits), global_gain.
+    const size_t header = (frame.size() > 1 && !(frame[1] & 1)) ? 9 : 7;
+    if (frame.size() > header + 2 && get_bits(&frame[header], 0, 3) == 0) bits.push_back(header * 8 + 7);
+    return bits;
+  }
+  FrameInfo f{};
+  if (!parse_frame(frame.data(), frame.size(), &f) || frame.size() < side_info_offset(f) + side_info_bytes(f)) {
+    return bits;
+  }
+  // Side info: main_data_begin, private bits, [scfsi], then per granule and
+  // channel part2_3_length (12), big_values (9), global_gain (8), ...
+  const int channels = f.mono ? 1 : 2;
+  const int granules = f.mpeg1 ? 2 : 1;
+  const size_t start = side_info_offset(f) * 8;
+  const size_t head = f.mpeg1 ? (9 + (f.mono ? 5 : 3) + 4 * channels) : (8 + (f.mono ? 1 : 2));
+  const size_t per_channel = f.mpeg1 ? 59 : 63;
+  for (int gr = 0; gr < granules; ++gr) {
+    for (int ch = 0; ch < channels; ++ch) {
+      bits.push_back(start + head + (gr * channels + ch) * per_channel + 21);
+    }
+  }
+  return bits;
+}
+
+bool decode_mp3(const std::vector<uint8_t>& data, const std::vector<size_t>& starts, std::vector<int16_t>* pcm,
+                std::vector<uint32_t>* frame_samples) {
+  auto stream = std::make_unique<mad_stream>();
+  auto frame = std::make_unique<mad_frame>();
+  auto synth = std::make_unique<mad_synth>();
+  mad_stream_init(stream.get());
+  mad_frame_init(frame.get());
+  mad_synth_init(synth.get());
+  // Same as AnnouncementPlayer; identical output for the mono clips.
+  mad_stream_options(stream.get(), MAD_OPTION_SINGLECHANNEL);
+  mad_stream_buffer(stream.get(), data.data(), data.size());
+  while (true) {
+    if (mad_frame_decode(frame.get(), stream.get()) == -1) {
+      if (stream->error == MAD_ERROR_BUFLEN || !MAD_RECOVERABLE(stream->error)) break;
+      continue;
+    }
+    const size_t at = static_cast<size_t>(stream->this_frame - data.data());
+    const size_t index = static_cast<size_t>(std::upper_bound(starts.begin(), starts.end(), at) - starts.begin()) - 1;
+    for (unsigned ns = 0; ns < MAD_NSBSAMPLES(&frame->header); ++ns) {
+      mad_synth_frame_onens(synth.get(), frame.get(), ns);
+      pcm->insert(pcm->end(), synth->pcm.samples[0], synth->pcm.samples[0] + synth->pcm.length);
+      (*frame_samples)[index] += synth->pcm.length;
+    }
+  }
+  mad_frame_finish(frame.get());
+  mad_stream_finish(stream.get());
+  return true;
+}
+
+bool decode_aac(const std::vector<uint8_t>& data, const std::vector<size_t>& starts, std::vector<int16_t>* pcm,
+                std::vector<uint32_t>* frame_samples) {
+  HAACDecoder dec = AACInitDecoder();
+  if (!dec) return false;
+  std::vector<short> out(2 * 2048);
+  // AudioGeneratorAAC decodes from each sync word and skips a frame it cannot decode.
+  for (size_t i = 0; i < starts.size(); ++i) {
+    unsigned char* in = const_cast<unsigned char*>(data.data() + starts[i]);
+    int left = static_cast<int>(data.size() - starts[i]);
+    if (AACDecode(dec, &in, &left, out.data()) != 0) continue;
+    AACFrameInfo fi;
+    AACGetLastFrameInfo(dec, &fi);
+    const int frames = fi.outputSamps / fi.nChans;
+    for (int k = 0; k < frames; ++k) pcm->push_back(out[k * fi.nChans]);
+    (*frame_samples)[i] = static_cast<uint32_t>(frames);
+  }
+  AACFreeDecoder(dec);
+  return true;
+}
+} // namespace
+
+bool load_mp3(const std::filesystem::path& path, CodedClip* clip) {
+  const std::vector<uint8_t> data = read_file(path);
+  size_t end = data.size();
+  if (end >= 128 && memcmp(&data[end - 128], "TAG", 3) == 0) end -= 128;
+
+  clip->codec = VoicePackCodec::kMp3;
+  clip->frames.clear();
+  size_t pos = id3v2_size(data);
+  FrameInfo f{};
+  while (pos < end && !parse_frame(&data[pos], end - pos, &f)) ++pos;
+  while (pos < end && parse_frame(&data[pos], end - pos, &f) && pos + f.bytes <= end) {
+    if (clip->sample_rate != 0 && clip->sample_rate != f.sample_rate) {
+      fprintf(stderr, "%s: sample rate changes mid-stream\n", path.string().c_str());
+      return false;
+    }
+    clip->sample_rate = f.sample_rate;
+    std::vector<uint8_t> frame(data.begin() + pos, data.begin() + pos + f.bytes);
+    if (!(clip->frames.empty() && is_vbr_header_frame(frame, f))) clip->frames.push_back(std::move(frame));
+    pos += f.bytes;
+  }
+  if (clip->frames.empty()) {
+    fprintf(stderr, "%s: no MPEG Layer III frames\n", path.string().c_str());
+    return false;
+  }
+  return true;
+}
+
+bool load_m4a(const std::filesystem::path& path, CodedClip* clip) {
+  static const uint32_t kRates[13] = {96000, 88200, 64000, 48000, 44100, 32000, 24000,
+                                      22050, 16000, 12000, 11025, 8000, 7350};
+  const std::vector<uint8_t> data = read_file(path);
+  Mp4AudioTrack track;
+  std::string error;
+  if (!mp4_read_audio_track(data, &track, &error)) {
+    fprintf(stderr, "%s: %s\n", path.string().c_str(), error.c_str());
+    return false;
+  }
+  // AudioSpecificConfig: object type (5 bits), rate index (4), channel config (4).
+  const std::vector<uint8_t>& asc = track.decoder_config;
+  const uint32_t object_type = asc.size() >= 2 ? get_bits(asc.data(), 0, 5) : 0;
+  const uint32_t rate_index = asc.size() >= 2 ? get_bits(asc.data(), 5, 4) : 15;
+  const uint32_t channels = asc.size() >= 2 ? get_bits(asc.data(), 9, 4) : 0;
+  if (track.object_type != 0x40 || object_type != 2 || rate_index > 12 || channels == 0 || channels > 2) {
+    fprintf(stderr, "%s: not mono/stereo AAC-LC\n", path.string().c_str());
+    return false;
+  }
+
+  clip->codec = VoicePackCodec::kAacAdts;
+  clip->sample_rate = kRates[rate_index];
+  clip->frames.clear();
+  for (const Mp4Sample& s : track.samples) {
+    const uint32_t len = s.size + 7;
+    std::vector<uint8_t> frame(7);
+    // ADTS header without CRC: MPEG-4, profile LC, one raw data block.
+    put_bits(frame.data(), 0, 12, 0xfff);
+    put_bits(frame.data(), 12, 1, 0);
+    put_bits(frame.data(), 13, 2, 0);
+    put_bits(frame.data(), 15, 1, 1);
+    put_bits(frame.data(), 16, 2, object_type - 1);
+    put_bits(frame.data(), 18, 4, rate_index);
+    put_bits(frame.data(), 22, 1, 0);
+    put_bits(frame.data(), 23, 3, channels);
+    put_bits(frame.data(), 26, 4, 0);
+    put_bits(frame.data(), 30, 13, len);
+    put_bits(frame.data(), 43, 11, 0x7ff);
+    put_bits(frame.data(), 54, 2, 0);
+    frame.insert(frame.end(), data.begin() + static_cast<ptrdiff_t>(s.offset),
+                 data.begin() + static_cast<ptrdiff_t>(s.offset + s.size));
+    clip->frames.push_back(std::move(frame));
+  }
+  return true;
+}
+
+bool opus_silk_payload(const int16_t* pcm, size_t count, uint32_t sample_rate, int kbps, std::vector<uint8_t>* out,
+                       uint32_t* skip, uint32_t* decoded) {
+  int err = 0;
+  OpusEncoder* enc = opus_encoder_create(static_cast<opus_int32>(sample_rate), 1, OPUS_APPLICATION_VOIP, &err);
+  if (!enc) {
+    fprintf(stderr, "Opus encoder: %s at %u Hz\n", opus_strerror(err), sample_rate);
+    return false;
+  }
+  opus_encoder_ctl(enc, OPUS_SET_FORCE_MODE(MODE_SILK_ONLY));
+  opus_encoder_ctl(enc, OPUS_SET_MAX_BANDWIDTH(OPUS_BANDWIDTH_WIDEBAND));
+  opus_encoder_ctl(enc, OPUS_SET_SIGNAL(OPUS_SIGNAL_VOICE));
+  opus_encoder_ctl(enc, OPUS_SET_BITRATE(kbps * 1000));
+  opus_encoder_ctl(enc, OPUS_SET_COMPLEXITY(10));
+  opus_int32 lookahead = 0;
+  opus_encoder_ctl(enc, OPUS_GET_LOOKAHEAD(&lookahead));
+
+  // Zeros after the speech push the codec delay out of the last packet.
+  const size_t per_packet = sample_rate * kOpusPacketMs / 1000;
+  std::vector<int16_t> in(pcm, pcm + count);
+  in.resize((count + static_cast<size_t>(lookahead) + per_packet - 1) / per_packet * per_packet, 0);
+  out->clear();
+  uint8_t packet[1275];
+  bool ok = true;
+  for (size_t i = 0; i < in.size(); i += per_packet) {
+    const int len = opus_encode(enc, &in[i], static_cast<int>(per_packet), packet, sizeof(packet));
+    ok = len > 0 && (packet[0] >> 3) < 12; // TOC config 0-11: SILK only
+    if (!ok) break;
+    out->push_back(static_cast<uint8_t>(len));
+    out->push_back(static_cast<uint8_t>(len >> 8));
+    out->insert(out->end(), packet, packet + len);
+  }
+  opus_encoder_destroy(enc);
+  if (!ok) {
+    fprintf(stderr, "Opus encoder: no SILK-only packet\n");
+    return false;
+  }
+  *skip = static_cast<uint32_t>(uint64_t(lookahead) * kOpusDecodeRate / sample_rate);
+  *decoded = static_cast<uint32_t>(in.size() / per_packet * kOpusDecodeRate * kOpusPacketMs / 1000);
+  return true;
+}
+
+std::vector<uint8_t> ima_adpcm_wav(const int16_t* pcm, size_t count, uint32_t sample_rate) {
+  const size_t per_block = static_cast<size_t>(ima_adpcm_block_samples(kAdpcmBlockBytes));
+  std::vector<uint8_t> data;
+  ima_adpcm_state state{0, 0};
+  uint8_t block[kAdpcmBlockBytes];
+  for (size_t i = 0; i < count; i += per_block) {
+    const int n = static_cast<int>(std::min(per_block, count - i));
+    const int bytes = ima_adpcm_encode_block(pcm + i, n, block, &state);
+    data.insert(data.end(), block, block + bytes);
+  }
+
+  std::vector<uint8_t> out;
+  auto u16 = [&out](uint32_t v) {
+    out.push_back(static_cast<uint8_t>(v));
+    out.push_back(static_cast<uint8_t>(v >> 8));
+  };
+  auto u32 = [&](uint32_t v) {
+    u16(v & 0xffff);
+    u16(v >> 16);
+  };
+  auto tag = [&out](const char* t) {
+    for (int i = 0; i < 4; ++i) out.push_back(static_cast<uint8_t>(t[i]));
+  };
+  const uint32_t data_bytes = static_cast<uint32_t>(data.size());
+  tag("RIFF");
+  u32(4 + 28 + 12 + 8 + data_bytes + (data_bytes & 1));
+  tag("WAVE");
+  tag("fmt ");
+  u32(20);
+  u16(0x0011);                                                   // IMA ADPCM
+  u16(1);                                                        // mono
+  u32(sample_rate);
+  u32(static_cast<uint32_t>(uint64_t(sample_rate) * kAdpcmBlockBytes / per_block));
+  u16(kAdpcmBlockBytes);
+  u16(4);                                                        // bits per sample
+  u16(2);                                                        // extra bytes
+  u16(static_cast<uint16_t>(per_block));
+  tag("fact");
+  u32(4);
+  u32(static_cast<uint32_t>(count));
+  tag("data");
+  u32(data_bytes);
+  out.insert(out.end(), data.begin(), data.end());
+  if (data_bytes & 1) out.push_back(0);
+  return out;
+}
+
+std::vector<uint8_t> payload(const CodedClip& clip, size_t first, size_t last) {
+  std::vector<uint8_t> out;
+  for (size_t i = first; i < last; ++i) out.insert(out.end(), clip.frames[i].begin(), clip.frames[i].end());
+  return out;
+}
+
+bool decode_frames(const CodedClip& clip, size_t first, size_t last, std::vector<int16_t>* pcm,
+                   std::vector<uint32_t>* frame_samples) {
+  pcm->clear();
+  frame_samples->assign(last - first, 0);
+  if (first >= last) return true;
+  std::vector<size_t> starts;
+  size_t at = 0;
+  for (size_t i = first; i < last; ++i) {
+    starts.push_back(at);
+    at += clip.frames[i].size();
+  }
+  std::vector<uint8_t> data = payload(clip, first, last);
+  // AudioGeneratorMP3 appends these at the end of the source so libmad decodes the last frame
+  if (clip.codec == VoicePackCodec::kMp3) data.resize(data.size() + MAD_BUFFER_GUARD, 0);
+  return clip.codec == VoicePackCodec::kAacAdts ? decode_aac(data, starts, pcm, frame_samples)
+                                                : decode_mp3(data, starts, pcm, frame_samples);
+}
+
+int shift_global_gain(CodedClip* clip, size_t first, size_t last, int steps) {
+  std::vector<std::vector<size_t>> fields;
+  int lo = 255;
+  int hi = 0;
+  for (size_t i = first; i < last; ++i) {
+    fields.push_back(global_gain_bits(*clip, clip->frames[i]));
+    if (fields.back().empty()) return 0; // a partial shift would change the sound, not just the level
+    for (size_t bit : fields.back()) {
+      const int g = static_cast<int>(get_bits(clip->frames[i].data(), bit, 8));
+      lo = std::min(lo, g);
+      hi = std::max(hi, g);
+    }
+  }
+  if (hi < lo) return 0;
+  steps = std::max(-lo, std::min(255 - hi, steps));
+  for (size_t i = first; i < last; ++i) {
+    for (size_t bit : fields[i - first]) {
+      uint8_t* p = clip->frames[i].data();
+      put_bits(p, bit, 8, static_cast<uint32_t>(static_cast<int>(get_bits(p, bit, 8)) + steps));
+    }
+  }
+  return steps;
+}
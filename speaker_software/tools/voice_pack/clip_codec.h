@@ -0,0 +1,48 @@
+#pragma once
+
+// Clip payloads as the packer sees them: a list of coded frames that can be
+// decoded, measured, cut at frame boundaries and gain-adjusted without
+// re-encoding.
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+#include "voice_pack_format.h"
+
+struct CodedClip {
+  VoicePackCodec codec = VoicePackCodec::kMp3;
+  uint32_t sample_rate = 0;
+  std::vector<std::vector<uint8_t>> frames; // MPEG frames, or ADTS frames for AAC
+};
+
+// MP3: ID3v1/ID3v2 tags and a leading Xing/Info/VBRI frame are dropped.
+bool load_mp3(const std::filesystem::path& path, CodedClip* clip);
+// M4A: AAC-LC access units of the first audio track, each given an ADTS header.
+bool load_m4a(const std::filesystem::path& path, CodedClip* clip);
+
+// Decodes frames [first, last) the way the firmware does: one buffer with
+// MAD_BUFFER_GUARD zeros after the last MP3 frame, frames that fail to decode
+// skipped. pcm receives mono samples, frame_samples[i] what frame first + i
+// produced (0 if it failed).
+bool decode_frames(const CodedClip& clip, size_t first, size_t last, std::vector<int16_t>* pcm,
+                   std::vector<uint32_t>* frame_samples);
+
+// Scales frames [first, last) by steps * 1.5 dB by shifting the global_gain
+// field of every granule (MP3) or single channel element (AAC). Returns the
+// step count actually applied, which is limited so no field wraps around,
+// or 0 if the frames have no field it can adjust.
+int shift_global_gain(CodedClip* clip, size_t first, size_t last, int steps);
+
+std::vector<uint8_t> payload(const CodedClip& clip, size_t first, size_t last);
+
+// Mono PCM as SILK-only Opus at kbps, the way AudioGeneratorSILK plays it:
+// 60 ms packets decoded at kOpusDecodeRate, each behind its 2-byte little-endian
+// length. skip receives the codec delay, decoded the samples all packets decode to.
+constexpr uint32_t kOpusDecodeRate = 16000;
+bool opus_silk_payload(const int16_t* pcm, size_t count, uint32_t sample_rate, int kbps, std::vector<uint8_t>* out,
+                       uint32_t* skip, uint32_t* decoded);
+
+// Mono PCM as a 4-bit IMA ADPCM WAV file (format 0x0011, fact chunk with the
+// exact sample count), as AudioGeneratorADPCM reads it.
+std::vector<uint8_t> ima_adpcm_wav(const int16_t* pcm, size_t count, uint32_t sample_rate);
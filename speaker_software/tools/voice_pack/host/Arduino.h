@@ -0,0 +1,11 @@
+#pragma once
+
+// Just enough of the Arduino core for the vendored decoders to build on the host.
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pgmspace.h"
@@ -0,0 +1,12 @@
+#pragma once
+
+// Flash and RAM share one address space on the host.
+
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(s) (s)
+#define pgm_read_byte(p) (*(const uint8_t*)(p))
+#define pgm_read_word(p) (*(const uint16_t*)(p))
+#define pgm_read_dword(p) (*(const uint32_t*)(p))
+#define memcpy_P memcpy
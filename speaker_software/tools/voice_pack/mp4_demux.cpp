@@ -0,0 +1,173 @@
+#include "mp4_demux.h"
+
+#include <cstring>
+#include <initializer_list>
+
+namespace {
+struct Box {
+  char type[5] = {};
+  size_t body = 0; // first byte after the box header
+  size_t end = 0;
+};
+
+uint32_t be32(const uint8_t* p) {
+  return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+}
+
+uint64_t be64(const uint8_t* p) {
+  return (uint64_t(be32(p)) << 32) | be32(p + 4);
+}
+
+// Reads the box header at `pos`; false if it does not fit inside [pos, end).
+bool read_box(const std::vector<uint8_t>& d, size_t pos, size_t end, Box* box) {
+  if (end - pos < 8) return false;
+  uint64_t size = be32(&d[pos]);
+  size_t header = 8;
+  if (size == 1) {
+    if (end - pos < 16) return false;
+    size = be64(&d[pos + 8]);
+    header = 16;
+  } else if (size == 0) {
+    size = end - pos;
+  }
+  if (size < header || size > end - pos) return false;
+  memcpy(box->type, &d[pos + 4], 4);
+  box->body = pos + header;
+  box->end = pos + static_cast<size_t>(size);
+  return true;
+}
+
+// First child of type `type` inside [pos, end).
+bool find_box(const std::vector<uint8_t>& d, size_t pos, size_t end, const char* type, Box* box) {
+  while (pos < end && read_box(d, pos, end, box)) {
+    if (memcmp(box->type, type, 4) == 0) return true;
+    pos = box->end;
+  }
+  return false;
+}
+
+// Descends through a path of nested boxes, e.g. {"mdia", "minf", "stbl"}.
+bool find_path(const std::vector<uint8_t>& d, const Box& parent, std::initializer_list<const char*> path, Box* box) {
+  Box cur = parent;
+  for (const char* type : path) {
+    if (!find_box(d, cur.body, cur.end, type, &cur)) return false;
+  }
+  *box = cur;
+  return true;
+}
+
+// MPEG-4 descriptor header (ISO 14496-1): tag and a 1-4 byte length.
+bool read_descriptor(const std::vector<uint8_t>& d, size_t* pos, size_t end, uint8_t* tag, size_t* len) {
+  if (*pos >= end) return false;
+  *tag = d[(*pos)++];
+  *len = 0;
+  for (int i = 0; i < 4; ++i) {
+    if (*pos >= end) return false;
+    const uint8_t b = d[(*pos)++];
+    *len = (*len << 7) | (b & 0x7f);
+    if (!(b & 0x80)) break;
+  }
+  return *len <= end - *pos;
+}
+
+bool parse_esds(const std::vector<uint8_t>& d, const Box& esds, Mp4AudioTrack* track) {
+  size_t pos = esds.body + 4; // version, flags
+  uint8_t tag;
+  size_t len;
+  if (!read_descriptor(d, &pos, esds.end, &tag, &len) || tag != 0x03 || len < 3) return false;
+  const size_t es_end = pos + len;
+  const uint8_t flags = d[pos + 2];
+  pos += 3; // ES_ID, flags
+  if (flags & 0x80) pos += 2;                          // dependsOn_ES_ID
+  if (flags & 0x40) pos += (pos < es_end ? d[pos] : 0) + 1; // URL
+  if (flags & 0x20) pos += 2;                          // OCR_ES_Id
+  if (!read_descriptor(d, &pos, es_end, &tag, &len) || tag != 0x04 || len < 13) return false;
+  const size_t dc_end = pos + len;
+  track->object_type = d[pos];
+  pos += 13;
+  if (!read_descriptor(d, &pos, dc_end, &tag, &len) || tag != 0x05 || len == 0) return false;
+  track->decoder_config.assign(d.begin() + pos, d.begin() + pos + len);
+  return true;
+}
+
+bool is_audio_track(const std::vector<uint8_t>& d, const Box& trak) {
+  Box hdlr;
+  return find_path(d, trak, {"mdia", "hdlr"}, &hdlr) && hdlr.end - hdlr.body >= 12 &&
+         memcmp(&d[hdlr.body + 8], "soun", 4) == 0;
+}
+} // namespace
+
+bool mp4_read_audio_track(const std::vector<uint8_t>& d, Mp4AudioTrack* track, std::string* error) {
+  Box moov;
+  if (!find_box(d, 0, d.size(), "moov", &moov)) {
+    *error = "no moov box";
+    return false;
+  }
+  Box trak;
+  size_t pos = moov.body;
+  bool found = false;
+  while (!found && find_box(d, pos, moov.end, "trak", &trak)) {
+    found = is_audio_track(d, trak);
+    pos = trak.end;
+  }
+  Box stbl;
+  if (!found || !find_path(d, trak, {"mdia", "minf", "stbl"}, &stbl)) {
+    *error = "no audio track";
+    return false;
+  }
+
+  // stsd -> mp4a -> esds; the mp4a sample entry has 28 bytes before its child boxes.
+  Box stsd, mp4a, esds;
+  if (!find_box(d, stbl.body, stbl.end, "stsd", &stsd) ||
+      !find_box(d, stsd.body + 8, stsd.end, "mp4a", &mp4a) ||
+      !find_box(d, mp4a.body + 28, mp4a.end, "esds", &esds) || !parse_esds(d, esds, track)) {
+    *error = "no mp4a/esds decoder config";
+    return false;
+  }
+
+  Box stsz, stsc, stco;
+  const bool co64 = !find_box(d, stbl.body, stbl.end, "stco", &stco);
+  if (!find_box(d, stbl.body, stbl.end, "stsz", &stsz) || !find_box(d, stbl.body, stbl.end, "stsc", &stsc) ||
+      (co64 && !find_box(d, stbl.body, stbl.end, "co64", &stco))) {
+    *error = "incomplete sample table";
+    return false;
+  }
+  const uint32_t fixed_size = be32(&d[stsz.body + 4]);
+  const uint32_t sample_count = be32(&d[stsz.body + 8]);
+  const uint32_t chunk_count = be32(&d[stco.body + 4]);
+  const uint32_t stsc_count = be32(&d[stsc.body + 4]);
+  if ((fixed_size == 0 && stsz.body + 12 + size_t(sample_count) * 4 > stsz.end) ||
+      stco.body + 8 + size_t(chunk_count) * (co64 ? 8 : 4) > stco.end ||
+      stsc.body + 8 + size_t(stsc_count) * 12 > stsc.end) {
+    *error = "truncated sample table";
+    return false;
+  }
+
+  // Walk the chunks: stsc gives runs of chunks with the same sample count.
+  track->samples.clear();
+  uint32_t sample = 0;
+  for (uint32_t run = 0; run < stsc_count; ++run) {
+    const uint8_t* e = &d[stsc.body + 8 + run * 12];
+    const uint32_t first = be32(e);
+    const uint32_t per_chunk = be32(e + 4);
+    const uint32_t last = (run + 1 < stsc_count) ? be32(e + 12) : chunk_count + 1;
+    for (uint32_t chunk = first; chunk < last && chunk <= chunk_count; ++chunk) {
+      const uint8_t* c = &d[stco.body + 8 + (chunk - 1) * (co64 ? 8 : 4)];
+      uint64_t offset = co64 ? be64(c) : be32(c);
+      for (uint32_t i = 0; i < per_chunk && sample < sample_count; ++i, ++sample) {
+        const uint32_t size = fixed_size ? fixed_size : be32(&d[stsz.body + 12 + sample * 4]);
+        if (offset + size > d.size()) {
+          *error = "sample outside the file";
+          return false;
+        }
+        track->samples.push_back({offset, size});
+        offset += size;
+      }
+    }
+  }
+  if (sample != sample_count || sample_count == 0) {
+    *error = "sample table does not cover all samples";
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+// Minimal MP4/M4A reader for the packer: the first audio track's decoder
+// config and the file offset and size of each of its samples.
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct Mp4Sample {
+  uint64_t offset;
+  uint32_t size;
+};
+
+struct Mp4AudioTrack {
+  uint32_t object_type = 0;             // from the esds descriptor, 0x40 = MPEG-4 audio
+  std::vector<uint8_t> decoder_config;  // AudioSpecificConfig
+  std::vector<Mp4Sample> samples;
+};
+
+// On failure returns false and describes the problem in *error.
+bool mp4_read_audio_track(const std::vector<uint8_t>& file, Mp4AudioTrack* track, std::string* error);
@@ -0,0 +1,420 @@
+// Compiles a directory of clips into one voice pack (voice_pack_format.h).
+//
+//   voice_pack [options] <clip_dir> <out.vpk>
+//
+//   --no-trim           keep the leading and trailing silence
+//   --no-normalize      keep each clip's own level
+//   --threshold-db <dB> speech detection level, default -45 dBFS
+//   --pad-ms <ms>       silence kept around the speech, default 10
+//   --target-db <dB>    loudness to normalize to, default -16 dBFS (kVoicePackLoudnessDb)
+//   --header <out.h>    also write the pack index as a C++ header
+//   --adpcm             store the speech as 4-bit IMA ADPCM instead
+//   --opus              store the speech as SILK-only Opus at 16 kHz instead
+//   --opus-kbps <kbps>  Opus bitrate, default 12
+//
+// The clips are all .mp3 or all .m4a (AAC-LC, stored as ADTS). Tags and
+// MP3 VBR header frames are dropped. Silence is trimmed at frame
+// boundaries: each clip keeps just the frames its speech needs to decode
+// bit-exactly, and skip/samples record where in the decoder output the
+// speech lies. Loudness is normalized in 1.5 dB steps by shifting the
+// global_gain fields, so nothing is re-encoded; each step rounds up, and
+// what is left over (and any step a clip could not take) is stored as the
+// clip's playback gain, an attenuation the device applies for free.
+//
+// With --adpcm the trimmed, leveled speech is decoded once more and stored
+// as IMA ADPCM WAV files cut to the exact sample: larger than MP3 (4 bits
+// per sample), but almost free to decode on the device.
+//
+// With --opus the same speech is encoded as mono SILK-only Opus packets
+// (voice_pack_format.h) in 60 ms packets: wideband speech at a fraction of
+// the MP3 size, decoded by the SILK layer alone. The pack rate is 16 kHz;
+// skip is the codec delay.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "clip_codec.h"
+#include "voice_pack_format.h"
+
+namespace {
+struct Options {
+  bool trim = true;
+  bool normalize = true;
+  double threshold_db = -45.0;
+  double pad_ms = 10.0;
+  bool has_target = false;
+  double target_db = 0.0;
+  const char* header = nullptr;
+  bool adpcm = false;
+  bool opus = false;
+  int opus_kbps = 12;
+  const char* clip_dir = nullptr;
+  const char* out = nullptr;
+};
+
+struct Clip {
+  std::string name;
+  uint32_t id = 0;
+  CodedClip coded;
+  size_t first = 0;  // kept frames [first, last)
+  size_t last = 0;
+  std::vector<uint32_t> frame_samples; // decoder output of the kept frames
+  uint32_t skip = 0;
+  uint32_t samples = 0;
+  double loudness_db = -100.0;
+  int peak = 0;
+  int gain_steps = 0;
+  uint16_t gain = kVoicePackUnityGain;
+  size_t source_bytes = 0;
+};
+
+constexpr double kGainStepDb = 1.5;
+
+double to_db(double amplitude) {
+  return 20.0 * std::log10(std::max(amplitude, 1e-9) / 32768.0);
+}
+
+// Gated RMS over 20 ms blocks: blocks below -60 dBFS are ignored, then
+// blocks more than 10 dB below the mean of the rest.
+double loudness_db(const int16_t* pcm, size_t count, uint32_t rate) {
+  const size_t block = std::max<size_t>(1, rate / 50);
+  std::vector<double> power;
+  for (size_t i = 0; i + block <= count; i += block) {
+    double sum = 0.0;
+    for (size_t k = 0; k < block; ++k) sum += double(pcm[i + k]) * pcm[i + k];
+    power.push_back(sum / block);
+  }
+  auto gated_mean = [&](double gate) {
+    double sum = 0.0;
+    size_t n = 0;
+    for (double p : power) {
+      if (p > gate) {
+        sum += p;
+        ++n;
+      }
+    }
+    return n ? sum / n : 0.0;
+  };
+  const double abs_gate = std::pow(10.0, -60.0 / 10.0) * 32768.0 * 32768.0;
+  const double mean = gated_mean(abs_gate);
+  if (mean <= 0.0) return -100.0;
+  return to_db(std::sqrt(gated_mean(std::max(abs_gate, mean / 10.0))));
+}
+
+bool frames_match(const std::vector<int16_t>& a, size_t a_pos, const std::vector<int16_t>& b, size_t b_pos,
+                  size_t count) {
+  return a_pos + count <= a.size() && b_pos + count <= b.size() &&
+         std::equal(a.begin() + a_pos, a.begin() + a_pos + count, b.begin() + b_pos);
+}
+
+// Finds the shortest run of frames whose decoder output contains samples
+// [begin, end) of the full clip's output unchanged.
+void choose_frames(Clip* c, const std::vector<int16_t>& pcm, const std::vector<uint32_t>& counts, size_t begin,
+                   size_t end) {
+  const size_t n = counts.size();
+  std::vector<size_t> at(n + 1, 0);
+  for (size_t k = 0; k < n; ++k) at[k + 1] = at[k] + counts[k];
+  size_t fa = 0;
+  while (fa + 1 < n && at[fa + 1] <= begin) ++fa;
+  size_t fb = fa;
+  while (fb + 1 < n && at[fb + 1] < end) ++fb;
+
+  std::vector<int16_t> out;
+  std::vector<uint32_t> out_counts;
+  for (size_t lead = 1; lead <= 8; ++lead) {
+    for (size_t tail = 1; tail <= 4; ++tail) {
+      const size_t first = fa > lead ? fa - lead : 0;
+      const size_t last = std::min(n, fb + 1 + tail);
+      decode_frames(c->coded, first, last, &out, &out_counts);
+      size_t pos = 0;
+      for (size_t k = first; k < fa; ++k) pos += out_counts[k - first];
+      bool ok = true;
+      size_t p = pos;
+      for (size_t k = fa; k <= fb && ok; ++k) {
+        ok = out_counts[k - first] == counts[k] && frames_match(out, p, pcm, at[k], counts[k]);
+        p += counts[k];
+      }
+      if (ok) {
+        c->first = first;
+        c->last = last;
+        c->frame_samples = out_counts;
+        c->skip = static_cast<uint32_t>(pos + (begin - at[fa]));
+        c->samples = static_cast<uint32_t>(end - begin);
+        return;
+      }
+    }
+  }
+  // Never reached in practice: the whole clip always reproduces itself.
+  c->first = 0;
+  c->last = n;
+  c->frame_samples = counts;
+  c->skip = static_cast<uint32_t>(begin);
+  c->samples = static_cast<uint32_t>(end - begin);
+}
+
+bool analyze(Clip* c, const Options& opt) {
+  std::vector<int16_t> pcm;
+  std::vector<uint32_t> counts;
+  decode_frames(c->coded, 0, c->coded.frames.size(), &pcm, &counts);
+  if (pcm.empty()) {
+    fprintf(stderr, "%s: nothing decodes\n", c->name.c_str());
+    return false;
+  }
+  size_t begin = 0;
+  size_t end = pcm.size();
+  if (opt.trim) {
+    const int threshold = static_cast<int>(32768.0 * std::pow(10.0, opt.threshold_db / 20.0));
+    const size_t pad = static_cast<size_t>(opt.pad_ms * c->coded.sample_rate / 1000.0);
+    size_t a = 0;
+    while (a < pcm.size() && std::abs(pcm[a]) <= threshold) ++a;
+    size_t b = pcm.size();
+    while (b > a && std::abs(pcm[b - 1]) <= threshold) --b;
+    if (a < b) {
+      begin = a > pad ? a - pad : 0;
+      end = std::min(pcm.size(), b + pad);
+    }
+  }
+  choose_frames(c, pcm, counts, begin, end);
+  c->loudness_db = loudness_db(&pcm[begin], end - begin, c->coded.sample_rate);
+  for (size_t i = begin; i < end; ++i) c->peak = std::max(c->peak, std::abs(int(pcm[i])));
+  return true;
+}
+
+// Playback gain for the dB still missing after the shift; attenuation only.
+uint16_t residual_gain(double db) {
+  if (db >= 0.0) return kVoicePackUnityGain;
+  return static_cast<uint16_t>(std::lround(kVoicePackUnityGain * std::pow(10.0, db / 20.0)));
+}
+
+// Shifts the clip by the steps it needs, backing off while the decoded
+// speech would clip. The frame sample counts must not change.
+void normalize(Clip* c, double target_db) {
+  int steps = static_cast<int>(std::ceil((target_db - c->loudness_db) / kGainStepDb));
+  while (steps > 0 && c->peak * std::pow(10.0, steps * kGainStepDb / 20.0) > 32767.0 * 0.95) --steps;
+  const CodedClip original = c->coded;
+  std::vector<int16_t> out;
+  std::vector<uint32_t> counts;
+  for (; steps != 0; steps += (steps > 0 ? -1 : 1)) {
+    c->coded = original;
+    const int applied = shift_global_gain(&c->coded, c->first, c->last, steps);
+    if (applied == 0) break;
+    decode_frames(c->coded, c->first, c->last, &out, &counts);
+    if (counts != c->frame_samples) continue;
+    int peak = 0;
+    for (uint32_t i = c->skip; i < c->skip + c->samples; ++i) peak = std::max(peak, std::abs(int(out[i])));
+    if (applied > 0 && peak >= 32767) continue;
+    c->gain_steps = applied;
+    c->gain = residual_gain(target_db - c->loudness_db - applied * kGainStepDb);
+    return;
+  }
+  c->coded = original;
+  c->gain_steps = 0;
+  c->gain = residual_gain(target_db - c->loudness_db);
+}
+
+std::string identifier(const std::string& s) {
+  std::string id;
+  for (char ch : s) id += (isalnum(static_cast<unsigned char>(ch)) ? ch : '_');
+  if (id.empty() || isdigit(static_cast<unsigned char>(id[0]))) id.insert(0, "_");
+  return id;
+}
+
+bool write_header(const char* path, const Options& opt, const std::vector<Clip>& clips, uint32_t rate) {
+  FILE* f = fopen(path, "w");
+  if (!f) return false;
+  const std::string ns = identifier(std::filesystem::path(opt.out).stem().string());
+  std::filesystem::path dir = std::filesystem::path(opt.clip_dir).lexically_normal();
+  if (dir.filename().empty()) dir = dir.parent_path(); // "data/mp3/"
+  fprintf(f, "// Generated by tools/voice_pack from %s/; do not edit.\n", dir.filename().string().c_str());
+  fprintf(f, "#pragma once\n\n#include <stdint.h>\n\nnamespace %s {\n", ns.c_str());
+  fprintf(f, "constexpr uint32_t kSampleRate = %u;\n", rate);
+  fprintf(f, "constexpr uint32_t kClipCount = %zu;\n\n", clips.size());
+  fprintf(f, "constexpr uint16_t kUnityGain = %u;\n\n", kVoicePackUnityGain);
+  fprintf(f, "// Sorted by id, like the pack table; samples exclude the trimmed silence,\n");
+  fprintf(f, "// gain is the Q15 playback gain (kUnityGain = 1.0).\n");
+  fprintf(f, "struct Clip {\n  const char* name;\n  uint32_t id;\n  uint32_t skip;\n  uint32_t samples;\n"
+             "  uint16_t gain;\n};\n\n");
+  fprintf(f, "constexpr Clip kClips[kClipCount] = {\n");
+  for (const Clip& c : clips) {
+    fprintf(f, "  {\"%s\", 0x%08xu, %u, %u, %u},\n", c.name.c_str(), c.id, c.skip, c.samples, c.gain);
+  }
+  fprintf(f, "};\n} // namespace %s\n", ns.c_str());
+  return fclose(f) == 0;
+}
+
+template <typename T>
+void put(std::vector<uint8_t>& out, const T& v) {
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(&v);
+  out.insert(out.end(), p, p + sizeof(T));
+}
+
+bool parse_args(int argc, char** argv, Options* opt) {
+  int i = 1;
+  for (; i < argc && strncmp(argv[i], "--", 2) == 0; ++i) {
+    const std::string a = argv[i];
+    const bool has_value = i + 1 < argc;
+    if (a == "--no-trim") {
+      opt->trim = false;
+    } else if (a == "--no-normalize") {
+      opt->normalize = false;
+    } else if (a == "--threshold-db" && has_value) {
+      opt->threshold_db = atof(argv[++i]);
+    } else if (a == "--pad-ms" && has_value) {
+      opt->pad_ms = atof(argv[++i]);
+    } else if (a == "--target-db" && has_value) {
+      opt->has_target = true;
+      opt->target_db = atof(argv[++i]);
+    } else if (a == "--header" && has_value) {
+      opt->header = argv[++i];
+    } else if (a == "--adpcm") {
+      opt->adpcm = true;
+    } else if (a == "--opus") {
+      opt->opus = true;
+    } else if (a == "--opus-kbps" && has_value) {
+      opt->opus_kbps = atoi(argv[++i]);
+    } else {
+      return false;
+    }
+  }
+  if (argc - i != 2 || (opt->adpcm && opt->opus) || opt->opus_kbps < 6 || opt->opus_kbps > 40) return false;
+  opt->clip_dir = argv[i];
+  opt->out = argv[i + 1];
+  return true;
+}
+} // namespace
+
+int main(int argc, char** argv) {
+  Options opt;
+  if (!parse_args(argc, argv, &opt)) {
+    fprintf(stderr,
+            "usage: %s [--no-trim] [--no-normalize] [--threshold-db dB] [--pad-ms ms]\n"
+            "          [--target-db dB] [--header out.h] [--adpcm | --opus [--opus-kbps kbps]]\n"
+            "          <clip_dir> <out.vpk>\n",
+            argv[0]);
+    return 2;
+  }
+  std::vector<Clip> clips;
+  for (const auto& e : std::filesystem::directory_iterator(opt.clip_dir)) {
+    const std::string ext = e.path().extension().string();
+    if (!e.is_regular_file() || (ext != ".mp3" && ext != ".m4a")) continue;
+    Clip clip;
+    clip.name = e.path().stem().string();
+    clip.id = voice_pack_clip_id(clip.name.data(), clip.name.size());
+    clip.source_bytes = e.file_size();
+    const bool loaded = ext == ".mp3" ? load_mp3(e.path(), &clip.coded) : load_m4a(e.path(), &clip.coded);
+    if (!loaded || !analyze(&clip, opt)) return 1;
+    clips.push_back(std::move(clip));
+  }
+  if (clips.empty()) {
+    fprintf(stderr, "%s: no clips\n", opt.clip_dir);
+    return 1;
+  }
+  std::sort(clips.begin(), clips.end(), [](const Clip& a, const Clip& b) { return a.id < b.id; });
+  for (size_t i = 0; i < clips.size(); ++i) {
+    const CodedClip& c = clips[i].coded;
+    if (c.codec != clips[0].coded.codec || c.sample_rate != clips[0].coded.sample_rate) {
+      fprintf(stderr, "%s: codec or rate differs from %s\n", clips[i].name.c_str(), clips[0].name.c_str());
+      return 1;
+    }
+    if (i > 0 && clips[i].id == clips[i - 1].id) {
+      fprintf(stderr, "clip id collision: %s / %s\n", clips[i - 1].name.c_str(), clips[i].name.c_str());
+      return 1;
+    }
+  }
+
+  if (opt.normalize) {
+    const double target = opt.has_target ? opt.target_db : kVoicePackLoudnessDb;
+    size_t adjusted = 0;
+    size_t attenuated = 0;
+    for (Clip& c : clips) {
+      if (c.loudness_db > -100.0) normalize(&c, target);
+      if (c.gain_steps != 0) ++adjusted;
+      if (c.gain != kVoicePackUnityGain) ++attenuated;
+    }
+    printf("loudness target %.1f dBFS, %zu clips adjusted, %zu with a playback gain\n", target, adjusted,
+           attenuated);
+  }
+
+  // Payload per clip; ADPCM and Opus clips hold just the speech.
+  std::vector<std::vector<uint8_t>> payloads;
+  for (Clip& c : clips) {
+    if (!opt.adpcm && !opt.opus) {
+      payloads.push_back(payload(c.coded, c.first, c.last));
+      continue;
+    }
+    std::vector<int16_t> pcm;
+    std::vector<uint32_t> counts;
+    decode_frames(c.coded, c.first, c.last, &pcm, &counts);
+    if (opt.adpcm) {
+      payloads.push_back(ima_adpcm_wav(&pcm[c.skip], c.samples, c.coded.sample_rate));
+      c.frame_samples.assign(1, c.samples);
+      c.skip = 0;
+      continue;
+    }
+    std::vector<uint8_t> bytes;
+    uint32_t decoded = 0;
+    if (!opus_silk_payload(&pcm[c.skip], c.samples, c.coded.sample_rate, opt.opus_kbps, &bytes, &c.skip, &decoded)) {
+      fprintf(stderr, "%s: Opus encoding failed\n", c.name.c_str());
+      return 1;
+    }
+    payloads.push_back(std::move(bytes));
+    c.frame_samples.assign(1, decoded);
+    c.samples = static_cast<uint32_t>((uint64_t(c.samples) * kOpusDecodeRate + c.coded.sample_rate / 2) /
+                                      c.coded.sample_rate);
+  }
+
+  VoicePackHeader hdr{};
+  memcpy(hdr.magic, kVoicePackMagic, sizeof(hdr.magic));
+  hdr.version = kVoicePackVersion;
+  hdr.codec = static_cast<uint16_t>(opt.adpcm  ? VoicePackCodec::kImaAdpcm
+                                    : opt.opus ? VoicePackCodec::kOpusSilk
+                                               : clips[0].coded.codec);
+  hdr.clip_count = static_cast<uint32_t>(clips.size());
+  hdr.table_offset = sizeof(VoicePackHeader);
+  hdr.data_offset = hdr.table_offset + hdr.clip_count * sizeof(VoicePackEntry);
+  hdr.sample_rate = opt.opus ? kOpusDecodeRate : clips[0].coded.sample_rate;
+
+  std::vector<uint8_t> table;
+  std::vector<uint8_t> data;
+  size_t source_bytes = 0;
+  uint64_t decoded_samples = 0;
+  uint64_t speech_samples = 0;
+  for (size_t i = 0; i < clips.size(); ++i) {
+    const Clip& c = clips[i];
+    const std::vector<uint8_t>& bytes = payloads[i];
+    while (data.size() % 4) data.push_back(0);
+    const VoicePackEntry entry{c.id, static_cast<uint32_t>(hdr.data_offset + data.size()),
+                               static_cast<uint32_t>(bytes.size()), c.skip, c.samples, c.gain, 0};
+    put(table, entry);
+    data.insert(data.end(), bytes.begin(), bytes.end());
+    source_bytes += c.source_bytes;
+    for (uint32_t n : c.frame_samples) decoded_samples += n;
+    speech_samples += c.samples;
+  }
+
+  std::vector<uint8_t> out;
+  put(out, hdr);
+  out.insert(out.end(), table.begin(), table.end());
+  out.insert(out.end(), data.begin(), data.end());
+  std::ofstream f(opt.out, std::ios::binary);
+  f.write(reinterpret_cast<const char*>(out.data()), static_cast<std::streamsize>(out.size()));
+  if (!f) {
+    fprintf(stderr, "%s: write failed\n", opt.out);
+    return 1;
+  }
+  if (opt.header && !write_header(opt.header, opt, clips, hdr.sample_rate)) {
+    fprintf(stderr, "%s: write failed\n", opt.header);
+    return 1;
+  }
+  printf("%s: %zu clips, %u Hz, %zu bytes (sources %zu bytes), %.1f s decoded, %.1f s speech\n", opt.out,
+         clips.size(), hdr.sample_rate, out.size(), source_bytes, double(decoded_samples) / hdr.sample_rate,
+         double(speech_samples) / hdr.sample_rate);
+  return 0;
+}